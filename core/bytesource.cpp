@@ -0,0 +1,209 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+#include "bytesource.h"
+#include "jpegfile.h"
+
+ByteSource::~ByteSource()
+{
+}
+
+long long ByteSource::size() const
+{
+    return -1;
+}
+
+size_t ByteSource::readSizeHint() const
+{
+    return 0;
+}
+
+void ByteSource::release(long long, long long)
+{
+}
+
+FileByteSource::FileByteSource(const std::string &fileName) :
+    m_fd(JpegFile::open(fileName)), m_isOwner(true)
+{
+}
+
+FileByteSource::FileByteSource(int fd) :
+    m_fd(fd), m_isOwner(false)
+{
+}
+
+FileByteSource::~FileByteSource()
+{
+    if (m_isOwner && (m_fd >= 0))
+        close(m_fd);
+}
+
+bool FileByteSource::isOpen() const
+{
+    return (m_fd >= 0);
+}
+
+long long FileByteSource::read(char *data, size_t size, long long position)
+{
+    JpegFile::noteCachedPages(m_fd, position, size, m_cached);
+    return JpegFile::read(m_fd, data, size, position);
+}
+
+long long FileByteSource::size() const
+{
+    struct stat info;
+    if (fstat(m_fd, &info) != 0)
+        return -1;
+    return info.st_size;
+}
+
+void FileByteSource::release(long long position, long long size)
+{
+    JpegFile::release(m_fd, position, position + size, m_cached);
+}
+
+MemoryByteSource::MemoryByteSource(const char *data, size_t size) :
+    m_data(data), m_size(size)
+{
+}
+
+long long MemoryByteSource::read(char *data, size_t size, long long position)
+{
+    if ((position < 0) || (position >= (long long)m_size))
+        return 0;
+
+    size = std::min<size_t>(size, m_size - position);
+    memcpy(data, m_data + position, size);
+    return size;
+}
+
+long long MemoryByteSource::size() const
+{
+    return m_size;
+}
+
+RangeByteSource::RangeByteSource(ByteSource &source, size_t rangeSize) :
+    m_source(source), m_rangeSize(std::max<size_t>(rangeSize, 1)),
+    m_requestCount(0), m_transferredSize(0)
+{
+}
+
+long long RangeByteSource::read(char *data, size_t size, long long position)
+{
+    if ((size == 0) || (position < 0))
+        return 0;
+
+    const long long first = position / m_rangeSize;
+    const long long last = (position + size - 1) / m_rangeSize;
+
+    // Missing ranges next to each other are fetched together
+    for (long long index = first; index <= last; index++) {
+        if (m_ranges.count(index))
+            continue;
+
+        long long end = index;
+        while ((end < last) && !m_ranges.count(end + 1))
+            end++;
+        if (!fetch(index, end))
+            return -1;
+        index = end;
+    }
+
+    size_t done = 0;
+    for (long long index = first; index <= last; index++) {
+        const std::string &range = m_ranges[index];
+        const long long offset = position + done - index * m_rangeSize;
+        if (offset >= (long long)range.size())
+            break;
+
+        const size_t length = std::min<size_t>(size - done,
+                                               range.size() - offset);
+        memcpy(data + done, range.data() + offset, length);
+        done += length;
+
+        // The end of the source
+        if (range.size() < m_rangeSize)
+            break;
+    }
+    return done;
+}
+
+bool RangeByteSource::fetch(long long first, long long last)
+{
+    std::string data((last - first + 1) * m_rangeSize, '\0');
+    const long long result = m_source.read(&data[0], data.size(),
+                                           first * m_rangeSize);
+    m_requestCount++;
+    if (result < 0)
+        return false;
+
+    m_transferredSize += result;
+    data.resize(result);
+    for (long long index = first; index <= last; index++) {
+        const size_t offset = (index - first) * m_rangeSize;
+        m_ranges[index] = (offset < data.size()) ?
+            data.substr(offset, m_rangeSize) : std::string();
+    }
+    return true;
+}
+
+long long RangeByteSource::size() const
+{
+    return m_source.size();
+}
+
+size_t RangeByteSource::readSizeHint() const
+{
+    return m_rangeSize;
+}
+
+int RangeByteSource::requestCount() const
+{
+    return m_requestCount;
+}
+
+long long RangeByteSource::transferredSize() const
+{
+    return m_transferredSize;
+}
@@ -0,0 +1,195 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#ifndef BYTE_SOURCE_H
+#define BYTE_SOURCE_H
+
+#include <stddef.h>
+#include <map>
+#include <string>
+#include <vector>
+
+/*!
+  Where an image is read from: anything which can give a range of bytes
+  at a given position, such as a local file, a buffer in memory or an
+  object in remote storage. The header of an image is read from the
+  source in a few ranges, so a remote image is never downloaded in full
+  only to read its metadata.
+ */
+
+class ByteSource
+{
+ public:
+    virtual ~ByteSource();
+
+    /*!
+      Reads a range of bytes.
+
+      @return the number of bytes read, which is less than the size only
+      at the end of the source, or -1 on failure.
+     */
+
+    virtual long long read(char *data, size_t size, long long position) = 0;
+
+    /*!
+      Returns the size of the source, or -1 if it is not known without
+      asking the source.
+     */
+
+    virtual long long size() const;
+
+    /*!
+      Returns how much is worth reading at once, as reading less costs
+      as much, or 0 for no preference.
+     */
+
+    virtual size_t readSizeHint() const;
+
+    /*!
+      Tells that a range which was read is not needed again, e.g. so
+      that it is dropped from a cache. Does nothing by default.
+     */
+
+    virtual void release(long long position, long long size);
+};
+
+/*!
+  A local file, read with pread() and the page cache hints of JpegFile.
+ */
+
+class FileByteSource : public ByteSource
+{
+ public:
+    explicit FileByteSource(const std::string &fileName);
+
+    /*!
+      Reads from an open file descriptor, e.g. one passed from another
+      process or a memfd. The descriptor is not closed by the source,
+      and its offset is not used.
+     */
+
+    explicit FileByteSource(int fd);
+    ~FileByteSource();
+
+    /*!
+      Returns false if the file could not be opened.
+     */
+
+    bool isOpen() const;
+
+    long long read(char *data, size_t size, long long position);
+    long long size() const;
+    void release(long long position, long long size);
+
+ private:
+    FileByteSource(const FileByteSource &);
+    FileByteSource &operator=(const FileByteSource &);
+
+    int m_fd;
+    bool m_isOwner;
+    // The pages which were cached before they were read
+    std::vector<unsigned char> m_cached;
+};
+
+/*!
+  A buffer in memory, which is not copied and has to outlive the source.
+ */
+
+class MemoryByteSource : public ByteSource
+{
+ public:
+    MemoryByteSource(const char *data, size_t size);
+
+    long long read(char *data, size_t size, long long position);
+    long long size() const;
+
+ private:
+    const char *m_data;
+    size_t m_size;
+};
+
+/*!
+  Reads another source in aligned ranges of a fixed size and keeps them,
+  the way an object store is read with HTTP range requests. Adjacent
+  missing ranges are fetched with one request.
+
+  Over a local source, this stands in for remote storage, and tells how
+  many requests would be made and how much would be transferred.
+ */
+
+class RangeByteSource : public ByteSource
+{
+ public:
+    /*!
+      @param source The source to fetch the ranges from.
+
+      @param rangeSize The size of the ranges.
+     */
+
+    explicit RangeByteSource(ByteSource &source, size_t rangeSize = 64 * 1024);
+
+    long long read(char *data, size_t size, long long position);
+    long long size() const;
+    size_t readSizeHint() const;
+
+    /*!
+      Returns the number of requests made to the underlying source.
+     */
+
+    int requestCount() const;
+
+    /*!
+      Returns the number of bytes fetched from the underlying source.
+     */
+
+    long long transferredSize() const;
+
+ private:
+    bool fetch(long long first, long long last);
+
+    ByteSource &m_source;
+    size_t m_rangeSize;
+    // The ranges fetched, by index; only the last one of the source
+    // may be short
+    std::map<long long, std::string> m_ranges;
+    int m_requestCount;
+    long long m_transferredSize;
+};
+
+#endif
@@ -0,0 +1,78 @@
+##########
+# the project file of the Qt-free core library
+##########
+
+TEMPLATE = lib
+equals(QT_MAJOR_VERSION, 4): TARGET = quillmetadata-core
+equals(QT_MAJOR_VERSION, 5): TARGET = quillmetadata-qt5-core
+
+# Plain C++ on top of libexif and libjpeg, usable without Qt
+CONFIG -= qt
+
+# libjpeg is loaded on first use, see jpeglibrary.cpp
+LIBS += -lexif -ldl
+# Generate pkg-config support by default
+# Note that we HAVE TO also create prl config as QMake implementation
+# mixes both of them together.
+CONFIG += create_pc create_prl no_install_prl
+QMAKE_PKGCONFIG_REQUIRES = libexif
+QMAKE_PKGCONFIG_INCDIR = $$[QT_INSTALL_HEADERS]/$$TARGET
+QMAKE_PKGCONFIG_LIBDIR = $$[QT_INSTALL_LIBS]
+
+QMAKE_CXXFLAGS += -Werror
+QMAKE_LFLAGS += -Wl,--as-needed
+
+# this is for adding coverage information while doing qmake as "qmake COV_OPTION=on"
+# message is shown when 'make' is executed
+for(OPTION,$$list($$lower($$COV_OPTION))){
+    isEqual(OPTION, on){
+        message("TEST COVERAGE IS ENABLED")
+        QMAKE_CXXFLAGS += -ftest-coverage -fprofile-arcs -fno-elide-constructors
+        LIBS += -lgcov
+    }
+}
+
+# --- input
+
+HEADERS += jpegheader.h \
+           jpeglibrary.h \
+           jpegfile.h \
+           bytesource.h \
+           jpegbatchreader.h \
+           exiflayout.h \
+           exifpatcher.h \
+           exifwriteback.h \
+           segmentwriteback.h \
+           exifarena.h
+
+SOURCES += jpegheader.cpp \
+           jpeglibrary.cpp \
+           jpegfile.cpp \
+           bytesource.cpp \
+           jpegbatchreader.cpp \
+           exiflayout.cpp \
+           exifpatcher.cpp \
+           exifwriteback.cpp \
+           segmentwriteback.cpp \
+           exifarena.cpp
+
+INSTALL_HEADERS = jpegheader.h \
+                  jpegfile.h \
+                  bytesource.h \
+                  jpegbatchreader.h \
+                  exiflayout.h \
+                  exifpatcher.h \
+                  exifwriteback.h \
+                  segmentwriteback.h \
+                  exifarena.h
+
+# --- install
+headers.files = $$INSTALL_HEADERS
+headers.path = $$[QT_INSTALL_HEADERS]/$$TARGET
+target.path = $$[QT_INSTALL_LIBS]
+pkgconfig.files = $${TARGET}.pc
+pkgconfig.path = $$[QT_INSTALL_LIBS]/pkgconfig
+INSTALLS += target headers pkgconfig
+
+
+QMAKE_CLEAN += *.gcov *.gcno *.log *.gcda
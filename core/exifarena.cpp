@@ -0,0 +1,256 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "exifarena.h"
+
+// Large enough for the entries of a typical camera Exif block
+static const size_t ChunkSize = 16 * 1024;
+static const size_t Alignment = 16;
+
+static __thread ExifArena *currentArena = 0;
+
+static inline size_t aligned(size_t size)
+{
+    return (size + Alignment - 1) & ~(Alignment - 1);
+}
+
+// Blocks in chunks can hold a free list link
+static inline size_t payloadSize(size_t size)
+{
+    return (size < Alignment) ? Alignment : aligned(size);
+}
+
+ExifArena::ExifArena() : m_mem(newMem()), m_chunks(0), m_used(0), m_last(0)
+{
+    memset(m_free, 0, sizeof(m_free));
+}
+
+ExifArena::~ExifArena()
+{
+    exif_mem_unref(m_mem);
+    while (m_chunks) {
+        Chunk *next = m_chunks->next;
+        free(m_chunks);
+        m_chunks = next;
+    }
+}
+
+ExifMem *ExifArena::mem()
+{
+    if (currentArena)
+        return currentArena->m_mem;
+
+    // Never released
+    static __thread ExifMem *heapMem = 0;
+    if (!heapMem)
+        heapMem = newMem();
+    return heapMem;
+}
+
+ExifMem *ExifArena::newMem()
+{
+    // libexif allocates the ExifMem itself with the given functions:
+    // keep it out of whichever arena happens to be current
+    Scope scope(0);
+    return exif_mem_new(memAlloc, memRealloc, memFree);
+}
+
+ExifArena::Scope::Scope(ExifArena *arena) : m_previous(currentArena)
+{
+    currentArena = arena;
+}
+
+ExifArena::Scope::~Scope()
+{
+    currentArena = m_previous;
+}
+
+char *ExifArena::chunkData(Chunk *chunk)
+{
+    return (char*)chunk + aligned(sizeof(Chunk));
+}
+
+void *ExifArena::payload(Block *block)
+{
+    return (char*)block + aligned(sizeof(Block));
+}
+
+ExifArena::Block *ExifArena::blockOf(void *ptr)
+{
+    return (Block*)((char*)ptr - aligned(sizeof(Block)));
+}
+
+ExifArena::Chunk *ExifArena::newChunk(size_t size)
+{
+    Chunk *chunk = (Chunk*)malloc(aligned(sizeof(Chunk)) + size);
+    if (chunk) {
+        chunk->next = 0;
+        chunk->size = size;
+    }
+    return chunk;
+}
+
+void *ExifArena::allocate(size_t size)
+{
+    const size_t blockSize = aligned(sizeof(Block)) + payloadSize(size);
+
+    // Large blocks, such as the buffer libexif grows while saving,
+    // are left to the C heap which can resize them in place
+    if (blockSize > ChunkSize / 4)
+        return heapAllocate(size);
+
+    const size_t freeList = payloadSize(size) / Alignment;
+    if ((freeList < FreeListCount) && m_free[freeList]) {
+        Block *block = m_free[freeList];
+        m_free[freeList] = *(Block**)payload(block);
+        memset(payload(block), 0, block->size);
+        return payload(block);
+    }
+
+    if (!m_chunks || (m_used + blockSize > m_chunks->size)) {
+        Chunk *chunk = newChunk(ChunkSize);
+        if (!chunk)
+            return 0;
+        chunk->next = m_chunks;
+        m_chunks = chunk;
+        m_used = 0;
+    }
+
+    Block *block = (Block*)(chunkData(m_chunks) + m_used);
+    m_used += blockSize;
+    m_last = block;
+
+    block->arena = this;
+    block->size = payloadSize(size);
+
+    // libexif expects zeroed memory, as from calloc()
+    memset(payload(block), 0, size);
+    return payload(block);
+}
+
+void *ExifArena::reallocate(Block *block, size_t size)
+{
+    if (aligned(size) <= block->size)
+        return payload(block);
+
+    // The most recent allocation can grow in place, within the sizes
+    // of the free lists
+    if ((block == m_last) &&
+        (aligned(sizeof(Block)) + aligned(size) <= ChunkSize / 4)) {
+        const size_t end = (char*)payload(block) - chunkData(m_chunks) +
+            aligned(size);
+        if (end <= m_chunks->size) {
+            m_used = end;
+            block->size = aligned(size);
+            return payload(block);
+        }
+    }
+
+    void *data = allocate(size);
+    if (!data)
+        return 0;
+    memcpy(data, payload(block), block->size);
+    release(block);
+    return data;
+}
+
+void ExifArena::release(Block *block)
+{
+    if (block == m_last) {
+        m_used = (char*)block - chunkData(m_chunks);
+        m_last = 0;
+        return;
+    }
+
+    // Blocks too large for the free lists stay until the arena goes
+    const size_t freeList = block->size / Alignment;
+    if (freeList < FreeListCount) {
+        *(Block**)payload(block) = m_free[freeList];
+        m_free[freeList] = block;
+    }
+}
+
+void *ExifArena::heapAllocate(size_t size)
+{
+    Block *block = (Block*)calloc(1, aligned(sizeof(Block)) + size);
+    if (!block)
+        return 0;
+    block->arena = 0;
+    block->size = size;
+    return payload(block);
+}
+
+void *ExifArena::memAlloc(ExifLong size)
+{
+    if (currentArena)
+        return currentArena->allocate(size);
+    else
+        return heapAllocate(size);
+}
+
+void *ExifArena::memRealloc(void *ptr, ExifLong size)
+{
+    if (!ptr)
+        return memAlloc(size);
+
+    Block *oldBlock = blockOf(ptr);
+    if (oldBlock->arena)
+        return oldBlock->arena->reallocate(oldBlock, size);
+
+    Block *newBlock = (Block*)realloc(oldBlock, aligned(sizeof(Block)) + size);
+    if (!newBlock)
+        return 0;
+    newBlock->size = size;
+    return payload(newBlock);
+}
+
+void ExifArena::memFree(void *ptr)
+{
+    if (!ptr)
+        return;
+
+    Block *oldBlock = blockOf(ptr);
+    if (oldBlock->arena)
+        oldBlock->arena->release(oldBlock);
+    else
+        free(oldBlock);
+}
@@ -0,0 +1,137 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#ifndef EXIF_ARENA_H
+#define EXIF_ARENA_H
+
+#include <stddef.h>
+#include <libexif/exif-mem.h>
+
+/*!
+  A bump allocator for the libexif data of one Exif object.
+
+  libexif allocates every IFD, entry and entry value separately. With
+  the arena, those are carved out of a few large chunks which are all
+  released when the arena is destroyed. Large blocks, such as the
+  buffer libexif grows while saving, come from the C heap and are freed
+  as usual. The most recent allocation is rolled back when freed; other
+  small blocks are kept for the next allocation of the same size, so
+  that an object which is edited or reloaded many times does not grow.
+
+  libexif allocator callbacks carry no context, so allocations go to
+  the arena made current on the calling thread with ExifArena::Scope;
+  outside any scope they fall back to the C heap. Every block records
+  its owner, so it can be reallocated or freed from any scope.
+ */
+
+class ExifArena
+{
+ public:
+    ExifArena();
+    ~ExifArena();
+
+    /*!
+      The libexif allocator of the current arena, or of the C heap
+      outside any scope. Each arena, and each thread outside of one,
+      has its own: libexif counts the references to an allocator
+      without any locking.
+     */
+
+    static ExifMem *mem();
+
+    /*!
+      Makes an arena current on the calling thread for the lifetime
+      of the scope.
+     */
+
+    class Scope
+    {
+     public:
+        Scope(ExifArena *arena);
+        ~Scope();
+
+     private:
+        ExifArena *m_previous;
+    };
+
+ private:
+    // One free list per block size, in steps of the alignment
+    static const size_t FreeListCount = 257;
+
+    struct Chunk {
+        Chunk *next;
+        size_t size;
+    };
+
+    struct Block {
+        ExifArena *arena; // 0 for blocks from the C heap
+        size_t size;
+    };
+
+    Chunk *newChunk(size_t size);
+
+    void *allocate(size_t size);
+    void *reallocate(Block *block, size_t size);
+    void release(Block *block);
+
+    static char *chunkData(Chunk *chunk);
+    static void *payload(Block *block);
+    static Block *blockOf(void *ptr);
+
+    static ExifMem *newMem();
+    static void *heapAllocate(size_t size);
+    static void *memAlloc(ExifLong size);
+    static void *memRealloc(void *ptr, ExifLong size);
+    static void memFree(void *ptr);
+
+ private:
+    ExifArena(const ExifArena &);
+    ExifArena &operator=(const ExifArena &);
+
+    ExifMem *m_mem;
+    // The current chunk is the first one
+    Chunk *m_chunks;
+    size_t m_used;
+    // The most recent allocation from the current chunk
+    Block *m_last;
+    // Freed blocks by size, linked through their payloads
+    Block *m_free[FreeListCount];
+};
+
+#endif
@@ -0,0 +1,109 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#include <string.h>
+
+#include "exiflayout.h"
+
+int ExifLayout::findEntry(const unsigned char *tiff, unsigned int size,
+                          ExifByteOrder byteOrder, unsigned int ifdOffset,
+                          int tag)
+{
+    const unsigned int entryLength = 12;
+
+    // The offsets come from the file, so the checks must not wrap
+    if ((ifdOffset < 8) || (ifdOffset > size) || (size - ifdOffset < 2))
+        return -1;
+
+    unsigned int count = exif_get_short(tiff + ifdOffset, byteOrder);
+    for (unsigned int i = 0; i < count; i++) {
+        unsigned int pos = ifdOffset + 2 + i * entryLength;
+        if ((pos > size) || (size - pos < entryLength))
+            return -1;
+        if (exif_get_short(tiff + pos, byteOrder) == tag)
+            return pos;
+    }
+    return -1;
+}
+
+bool ExifLayout::thumbnail(const char *block, size_t blockSize,
+                           size_t &thumbnailOffset, size_t &thumbnailLength)
+{
+    if ((blockSize < (size_t)HeaderLength + 8) ||
+        (memcmp(block, "Exif\0\0", HeaderLength) != 0))
+        return false;
+
+    const unsigned char *tiff = (const unsigned char*)block + HeaderLength;
+    const unsigned int size = blockSize - HeaderLength;
+    ExifByteOrder byteOrder =
+        (tiff[0] == 'I') ? EXIF_BYTE_ORDER_INTEL : EXIF_BYTE_ORDER_MOTOROLA;
+
+    // IFD1 is linked from the end of IFD0
+    const unsigned int ifd0 = exif_get_long(tiff + 4, byteOrder);
+    if ((ifd0 < 8) || (ifd0 > size) || (size - ifd0 < 2))
+        return false;
+    const unsigned int tableSize = 12 * exif_get_short(tiff + ifd0, byteOrder);
+    if (size - ifd0 - 2 < tableSize)
+        return false;
+    const unsigned int next = ifd0 + 2 + tableSize;
+    if (size - next < 4)
+        return false;
+    const unsigned int ifd1 = exif_get_long(tiff + next, byteOrder);
+
+    const int offsetPos = findEntry(tiff, size, byteOrder, ifd1,
+                                    EXIF_TAG_JPEG_INTERCHANGE_FORMAT);
+    const int lengthPos = findEntry(tiff, size, byteOrder, ifd1,
+                                    EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH);
+    if ((offsetPos < 0) || (lengthPos < 0))
+        return false;
+
+    // The length is a LONG, but some writers use a SHORT
+    const unsigned int offset = exif_get_long(tiff + offsetPos + 8, byteOrder);
+    const unsigned int length =
+        (exif_get_short(tiff + lengthPos + 2, byteOrder) == EXIF_FORMAT_SHORT) ?
+        exif_get_short(tiff + lengthPos + 8, byteOrder) :
+        exif_get_long(tiff + lengthPos + 8, byteOrder);
+    if ((offset > size) || (length < 2) || (length > size - offset) ||
+        (tiff[offset] != 0xff) || (tiff[offset + 1] != 0xd8))
+        return false;
+
+    thumbnailOffset = HeaderLength + offset;
+    thumbnailLength = length;
+    return true;
+}
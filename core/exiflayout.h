@@ -0,0 +1,80 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#ifndef EXIF_LAYOUT_H
+#define EXIF_LAYOUT_H
+
+#include <stddef.h>
+#include <libexif/exif-data.h>
+
+/*!
+  Lookups in the raw TIFF structure of an Exif block, for what libexif
+  does not expose or would need a full load for.
+ */
+
+class ExifLayout
+{
+ public:
+    // "Exif\0\0" before the TIFF header
+    static const int HeaderLength = 6;
+
+    /*!
+      Returns the position of the entry with a given tag in a TIFF IFD,
+      or -1 if the IFD has no such entry or is out of bounds.
+     */
+
+    static int findEntry(const unsigned char *tiff, unsigned int size,
+                         ExifByteOrder byteOrder, unsigned int ifdOffset,
+                         int tag);
+
+    /*!
+      Finds the JPEG thumbnail linked from IFD1 of an Exif block.
+
+      @param offset Set to the position of the thumbnail in the block.
+
+      @param length Set to the length of the thumbnail.
+
+      @return false if the block has no valid thumbnail.
+     */
+
+    static bool thumbnail(const char *block, size_t size,
+                          size_t &offset, size_t &length);
+};
+
+#endif
@@ -0,0 +1,411 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#include <string.h>
+
+#include "exifpatcher.h"
+
+// "Exif\0\0" before the TIFF header
+static const int HeaderLength = 6;
+static const int EntryLength = 12;
+// An APP1 segment holds at most 65533 bytes of payload
+static const int MaximumBlockSize = 65533;
+
+ExifPatcher::Value::Value() :
+    format(0), components(0), isRemoved(true)
+{
+}
+
+ExifPatcher::Value::Value(const ExifEntry *entry) :
+    format(entry->format), components(entry->components),
+    data((const char*)entry->data, entry->size), isRemoved(false)
+{
+}
+
+ExifPatcher::Value::Value(unsigned int offset, ExifByteOrder byteOrder) :
+    format(EXIF_FORMAT_LONG), components(1), data(4, '\0'), isRemoved(false)
+{
+    exif_set_long((unsigned char*)&data[0], byteOrder, offset);
+}
+
+ExifPatcher::Value::Value(ExifFormat format, const std::string &data) :
+    format(format), components(data.size() / exif_format_get_size(format)),
+    data(data), isRemoved(false)
+{
+}
+
+ExifPatcher::Ifd::Ifd() : offset(0), count(0), hasLink(false), nextOffset(0)
+{
+}
+
+ExifPatcher::ExifPatcher(const std::string &exifBlock) :
+    m_block(exifBlock), m_byteOrder(EXIF_BYTE_ORDER_INTEL), m_isValid(false)
+{
+    if ((m_block.size() < HeaderLength + 8) ||
+        (memcmp(m_block.data(), "Exif\0\0", HeaderLength) != 0))
+        return;
+
+    const unsigned char *tiff =
+        (const unsigned char*)m_block.data() + HeaderLength;
+    if ((tiff[0] == 'I') && (tiff[1] == 'I'))
+        m_byteOrder = EXIF_BYTE_ORDER_INTEL;
+    else if ((tiff[0] == 'M') && (tiff[1] == 'M'))
+        m_byteOrder = EXIF_BYTE_ORDER_MOTOROLA;
+    else
+        return;
+
+    if (exif_get_short(tiff + 2, m_byteOrder) != 42)
+        return;
+
+    if (!readIfd(EXIF_IFD_0, exif_get_long(tiff + 4, m_byteOrder)))
+        return;
+
+    // Other IFDs are optional, but must be valid if they are there
+    unsigned int offset;
+    if ((offset = pointer(EXIF_IFD_0, EXIF_TAG_EXIF_IFD_POINTER)) &&
+        !readIfd(EXIF_IFD_EXIF, offset))
+        return;
+    if ((offset = pointer(EXIF_IFD_0, EXIF_TAG_GPS_INFO_IFD_POINTER)) &&
+        !readIfd(EXIF_IFD_GPS, offset))
+        return;
+    if ((offset = pointer(EXIF_IFD_EXIF, EXIF_TAG_INTEROPERABILITY_IFD_POINTER)) &&
+        !readIfd(EXIF_IFD_INTEROPERABILITY, offset))
+        return;
+    if ((offset = m_ifds[EXIF_IFD_0].nextOffset) &&
+        !readIfd(EXIF_IFD_1, offset))
+        return;
+
+    m_isValid = true;
+}
+
+bool ExifPatcher::isValid() const
+{
+    return m_isValid;
+}
+
+bool ExifPatcher::readIfd(ExifIfd ifd, unsigned int offset)
+{
+    const unsigned int tiffSize = m_block.size() - HeaderLength;
+    const unsigned char *tiff =
+        (const unsigned char*)m_block.data() + HeaderLength;
+
+    // The offset comes from the file, so the checks must not wrap
+    if ((offset < 8) || (offset > tiffSize) || (tiffSize - offset < 2))
+        return false;
+
+    const unsigned int count = exif_get_short(tiff + offset, m_byteOrder);
+    if (tiffSize - offset - 2 < count * EntryLength)
+        return false;
+    const unsigned int tableEnd = offset + 2 + count * EntryLength;
+
+    Ifd &result = m_ifds[ifd];
+    result.offset = offset;
+    result.count = count;
+    for (unsigned int i = 0; i < count; i++) {
+        const unsigned int pos = offset + 2 + i * EntryLength;
+        result.entries[exif_get_short(tiff + pos, m_byteOrder)] =
+            HeaderLength + pos;
+    }
+    // Some writers leave out the link of the last IFD
+    result.hasLink = (tiffSize - tableEnd >= 4);
+    if (result.hasLink)
+        result.nextOffset = exif_get_long(tiff + tableEnd, m_byteOrder);
+
+    return true;
+}
+
+unsigned int ExifPatcher::pointer(ExifIfd ifd, int tag) const
+{
+    if (!m_ifds[ifd].entries.count(tag))
+        return 0;
+
+    const int pos = m_ifds[ifd].entries.find(tag)->second;
+    return exif_get_long((const unsigned char*)m_block.data() + pos + 8,
+                         m_byteOrder);
+}
+
+std::string ExifPatcher::patch(const std::map<unsigned int, const ExifEntry*> &entries,
+                               const std::string &thumbnail) const
+{
+    if (!m_isValid)
+        return std::string();
+
+    // The JPEG tags would contradict the strips of an uncompressed
+    // thumbnail, which is there already
+    if (!thumbnail.empty() &&
+        m_ifds[EXIF_IFD_1].entries.count(EXIF_TAG_STRIP_OFFSETS))
+        return std::string();
+
+    std::map<int, Value> changes[EXIF_IFD_COUNT];
+    std::map<unsigned int, const ExifEntry*>::const_iterator i;
+    for (i = entries.begin(); i != entries.end(); ++i) {
+        const int ifd = i->first >> 16;
+        if (ifd < EXIF_IFD_COUNT)
+            changes[ifd][i->first & 0xffff] =
+                i->second ? Value(i->second) : Value();
+    }
+
+    std::string block = m_block;
+    unsigned int offsets[EXIF_IFD_COUNT];
+
+    // Children go first, as their offsets are written into their parents
+    offsets[EXIF_IFD_INTEROPERABILITY] =
+        writeIfd(block, EXIF_IFD_INTEROPERABILITY,
+                 changes[EXIF_IFD_INTEROPERABILITY],
+                 m_ifds[EXIF_IFD_INTEROPERABILITY].nextOffset);
+    if (offsets[EXIF_IFD_INTEROPERABILITY] !=
+        m_ifds[EXIF_IFD_INTEROPERABILITY].offset)
+        changes[EXIF_IFD_EXIF][EXIF_TAG_INTEROPERABILITY_IFD_POINTER] =
+            offsets[EXIF_IFD_INTEROPERABILITY] ?
+            Value(offsets[EXIF_IFD_INTEROPERABILITY], m_byteOrder) : Value();
+
+    offsets[EXIF_IFD_EXIF] =
+        writeIfd(block, EXIF_IFD_EXIF, changes[EXIF_IFD_EXIF],
+                 m_ifds[EXIF_IFD_EXIF].nextOffset);
+    if (offsets[EXIF_IFD_EXIF] != m_ifds[EXIF_IFD_EXIF].offset)
+        changes[EXIF_IFD_0][EXIF_TAG_EXIF_IFD_POINTER] =
+            offsets[EXIF_IFD_EXIF] ?
+            Value(offsets[EXIF_IFD_EXIF], m_byteOrder) : Value();
+
+    offsets[EXIF_IFD_GPS] =
+        writeIfd(block, EXIF_IFD_GPS, changes[EXIF_IFD_GPS],
+                 m_ifds[EXIF_IFD_GPS].nextOffset);
+    if (offsets[EXIF_IFD_GPS] != m_ifds[EXIF_IFD_GPS].offset)
+        changes[EXIF_IFD_0][EXIF_TAG_GPS_INFO_IFD_POINTER] =
+            offsets[EXIF_IFD_GPS] ?
+            Value(offsets[EXIF_IFD_GPS], m_byteOrder) : Value();
+
+    if (!thumbnail.empty())
+        addThumbnailEntries(changes[EXIF_IFD_1], thumbnail.size());
+
+    offsets[EXIF_IFD_1] =
+        writeIfd(block, EXIF_IFD_1, changes[EXIF_IFD_1],
+                 m_ifds[EXIF_IFD_1].nextOffset);
+
+    // The thumbnail offset is only known once IFD1 has been written
+    if (!thumbnail.empty()) {
+        align(block);
+        setLong(block, offsets[EXIF_IFD_1], EXIF_TAG_JPEG_INTERCHANGE_FORMAT,
+                block.size() - HeaderLength);
+        block.append(thumbnail);
+    }
+
+    offsets[EXIF_IFD_0] =
+        writeIfd(block, EXIF_IFD_0, changes[EXIF_IFD_0], offsets[EXIF_IFD_1]);
+    if (offsets[EXIF_IFD_0] != m_ifds[EXIF_IFD_0].offset)
+        exif_set_long((unsigned char*)&block[0] + HeaderLength + 4,
+                      m_byteOrder, offsets[EXIF_IFD_0]);
+
+    if (block.size() > MaximumBlockSize)
+        return std::string();
+
+    return block;
+}
+
+bool ExifPatcher::canWriteInPlace(ExifIfd ifd,
+                                  const std::map<int, Value> &changes) const
+{
+    const Ifd &original = m_ifds[ifd];
+    if (original.offset == 0)
+        return false;
+
+    const unsigned int tiffSize = m_block.size() - HeaderLength;
+    const unsigned char *data = (const unsigned char*)m_block.data();
+
+    std::map<int, Value>::const_iterator i;
+    for (i = changes.begin(); i != changes.end(); ++i) {
+        if (i->second.isRemoved || !original.entries.count(i->first))
+            return false;
+
+        const unsigned char *entry = data + original.entries.find(i->first)->second;
+        const unsigned int size = i->second.data.size();
+        if ((exif_get_short(entry + 2, m_byteOrder) != i->second.format) ||
+            (exif_get_long(entry + 4, m_byteOrder) != i->second.components) ||
+            (size != exif_format_get_size((ExifFormat)i->second.format) *
+             i->second.components))
+            return false;
+
+        if (size > 4) {
+            const unsigned int valueOffset = exif_get_long(entry + 8, m_byteOrder);
+            if ((valueOffset > tiffSize) || (size > tiffSize - valueOffset))
+                return false;
+        }
+    }
+    return true;
+}
+
+void ExifPatcher::addThumbnailEntries(std::map<int, Value> &changes,
+                                      unsigned int size) const
+{
+    std::string value(2, '\0');
+    exif_set_short((unsigned char*)&value[0], m_byteOrder, 6); // JPEG
+    changes[EXIF_TAG_COMPRESSION] = Value(EXIF_FORMAT_SHORT, value);
+
+    // Resolution is mandatory in IFD1, 72 dpi is the usual default
+    const Ifd &ifd1 = m_ifds[EXIF_IFD_1];
+    if (!ifd1.entries.count(EXIF_TAG_RESOLUTION_UNIT)) {
+        exif_set_short((unsigned char*)&value[0], m_byteOrder, 2); // inches
+        changes[EXIF_TAG_RESOLUTION_UNIT] =
+            Value(EXIF_FORMAT_SHORT, value);
+    }
+
+    ExifRational resolution = { 72, 1 };
+    std::string rational(8, '\0');
+    exif_set_rational((unsigned char*)&rational[0], m_byteOrder, resolution);
+    if (!ifd1.entries.count(EXIF_TAG_X_RESOLUTION))
+        changes[EXIF_TAG_X_RESOLUTION] =
+            Value(EXIF_FORMAT_RATIONAL, rational);
+    if (!ifd1.entries.count(EXIF_TAG_Y_RESOLUTION))
+        changes[EXIF_TAG_Y_RESOLUTION] =
+            Value(EXIF_FORMAT_RATIONAL, rational);
+
+    changes[EXIF_TAG_JPEG_INTERCHANGE_FORMAT] = Value(0, m_byteOrder);
+    changes[EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH] =
+        Value(size, m_byteOrder);
+}
+
+void ExifPatcher::setLong(std::string &block, unsigned int ifdOffset, int tag,
+                          unsigned int value) const
+{
+    unsigned char *ifd = (unsigned char*)&block[0] + HeaderLength + ifdOffset;
+    const unsigned int count = exif_get_short(ifd, m_byteOrder);
+
+    for (unsigned int i = 0; i < count; i++) {
+        unsigned char *entry = ifd + 2 + i * EntryLength;
+        if (exif_get_short(entry, m_byteOrder) == tag) {
+            exif_set_long(entry + 8, m_byteOrder, value);
+            return;
+        }
+    }
+}
+
+unsigned int ExifPatcher::writeIfd(std::string &block, ExifIfd ifd,
+                                   const std::map<int, Value> &changes,
+                                   unsigned int nextOffset) const
+{
+    const Ifd &original = m_ifds[ifd];
+
+    if (changes.empty() && (nextOffset == original.nextOffset))
+        return original.offset;
+
+    // Without a link in the block, a new one needs a new IFD
+    const bool canLink = (nextOffset == original.nextOffset) || original.hasLink;
+    if (canLink && canWriteInPlace(ifd, changes)) {
+        std::map<int, Value>::const_iterator i;
+        for (i = changes.begin(); i != changes.end(); ++i) {
+            unsigned char *entry =
+                (unsigned char*)&block[0] + original.entries.find(i->first)->second;
+            const unsigned int size = i->second.data.size();
+            unsigned char *value = (size > 4) ?
+                (unsigned char*)&block[0] + HeaderLength +
+                exif_get_long(entry + 8, m_byteOrder) :
+                entry + 8;
+            memcpy(value, i->second.data.data(), size);
+        }
+
+        if (nextOffset != original.nextOffset)
+            exif_set_long((unsigned char*)&block[0] + HeaderLength +
+                          original.offset + 2 + original.count * EntryLength,
+                          m_byteOrder, nextOffset);
+        return original.offset;
+    }
+
+    // Unmodified entries are copied as they are, their values stay put
+    std::map<int, int> kept = original.entries;
+    std::map<int, Value> modified;
+    std::map<int, Value>::const_iterator i;
+    for (i = changes.begin(); i != changes.end(); ++i) {
+        kept.erase(i->first);
+        if (!i->second.isRemoved)
+            modified[i->first] = i->second;
+    }
+
+    const int count = kept.size() + modified.size();
+    if ((count == 0) && (ifd != EXIF_IFD_0))
+        return 0;
+
+    align(block);
+    const unsigned int offset = block.size() - HeaderLength;
+    block.resize(block.size() + 2 + count * EntryLength + 4);
+    exif_set_short((unsigned char*)&block[0] + HeaderLength + offset,
+                   m_byteOrder, count);
+
+    // TIFF requires entries in ascending tag order
+    int pos = HeaderLength + offset + 2;
+    std::map<int, int>::const_iterator k = kept.begin();
+    std::map<int, Value>::const_iterator m = modified.begin();
+    while ((k != kept.end()) || (m != modified.end())) {
+        if ((m == modified.end()) ||
+            ((k != kept.end()) && (k->first < m->first))) {
+            memcpy(&block[pos], m_block.data() + k->second,
+                   EntryLength);
+            ++k;
+        }
+        else {
+            const Value &value = m->second;
+            unsigned char *entry = (unsigned char*)&block[0] + pos;
+            exif_set_short(entry, m_byteOrder, m->first);
+            exif_set_short(entry + 2, m_byteOrder, value.format);
+            exif_set_long(entry + 4, m_byteOrder, value.components);
+            memset(entry + 8, 0, 4);
+
+            if (value.data.size() <= 4)
+                memcpy(entry + 8, value.data.data(), value.data.size());
+            else {
+                align(block);
+                const unsigned int valueOffset = block.size() - HeaderLength;
+                block.append(value.data);
+                exif_set_long((unsigned char*)&block[0] + pos + 8,
+                              m_byteOrder, valueOffset);
+            }
+            ++m;
+        }
+        pos += EntryLength;
+    }
+    exif_set_long((unsigned char*)&block[0] + pos, m_byteOrder, nextOffset);
+
+    return offset;
+}
+
+void ExifPatcher::align(std::string &block)
+{
+    // Values and IFDs start at word boundaries
+    if ((block.size() - HeaderLength) & 1)
+        block.push_back('\0');
+}
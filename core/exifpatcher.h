@@ -0,0 +1,142 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#ifndef EXIF_PATCHER_H
+#define EXIF_PATCHER_H
+
+#include <libexif/exif-data.h>
+#include <string>
+#include <map>
+
+/*!
+  Rewrites an Exif block byte for byte, changing only what was edited.
+
+  Entries of the original block are kept where they are. Modified
+  values which still fit are overwritten in place; otherwise the IFDs
+  containing modified entries are re-encoded at the end of the block,
+  with their unmodified entries still pointing to the original values,
+  and the pointers to those IFDs are updated. Tags unknown to libexif
+  and MakerNotes using absolute offsets thus survive any edit.
+ */
+
+class ExifPatcher
+{
+ public:
+    /*!
+      Parses the structure of an Exif block, including its "Exif"
+      header.
+     */
+
+    ExifPatcher(const std::string &exifBlock);
+
+    /*!
+      Returns true if the block has a valid TIFF structure.
+     */
+
+    bool isValid() const;
+
+    /*!
+      Returns the block with modified entries. Modified entries are
+      keyed by (ifd << 16 | tag), and are removed from the block if
+      their value is 0.
+
+      If a JPEG thumbnail is given, it is appended to the block and
+      linked from IFD1, which is created if needed. A block whose IFD1
+      holds an uncompressed thumbnail cannot take one.
+
+      Returns an empty byte array if the block cannot be patched, or
+      if the result would not fit into an APP1 segment.
+     */
+
+    std::string patch(const std::map<unsigned int, const ExifEntry*> &entries,
+                      const std::string &thumbnail = std::string()) const;
+
+ private:
+    struct Value {
+        Value();
+        Value(const ExifEntry *entry);
+        Value(unsigned int offset, ExifByteOrder byteOrder);
+        Value(ExifFormat format, const std::string &data);
+
+        int format;
+        unsigned int components;
+        std::string data;
+        bool isRemoved;
+    };
+
+    struct Ifd {
+        Ifd();
+
+        // Offset of the IFD from the TIFF header, 0 if it does not exist
+        unsigned int offset;
+        // Positions of its entries in the block, by tag
+        std::map<int, int> entries;
+        // The number of entries in the block, duplicate tags included
+        unsigned int count;
+        // Whether the block has room for the link to the next IFD
+        bool hasLink;
+        unsigned int nextOffset;
+    };
+
+    bool readIfd(ExifIfd ifd, unsigned int offset);
+
+    unsigned int pointer(ExifIfd ifd, int tag) const;
+
+    unsigned int writeIfd(std::string &block, ExifIfd ifd,
+                          const std::map<int, Value> &changes,
+                          unsigned int nextOffset) const;
+
+    bool canWriteInPlace(ExifIfd ifd, const std::map<int, Value> &changes) const;
+
+    void addThumbnailEntries(std::map<int, Value> &changes,
+                             unsigned int size) const;
+
+    void setLong(std::string &block, unsigned int ifdOffset, int tag,
+                 unsigned int value) const;
+
+    static void align(std::string &block);
+
+ private:
+    std::string m_block;
+    ExifByteOrder m_byteOrder;
+    Ifd m_ifds[EXIF_IFD_COUNT];
+    bool m_isValid;
+};
+
+#endif
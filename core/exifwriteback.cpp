@@ -0,0 +1,385 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#include <fcntl.h>
+#include <setjmp.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "exifwriteback.h"
+#include "exifpatcher.h"
+#include "jpeglibrary.h"
+#include "bytesource.h"
+#include "jpegfile.h"
+
+// Longer side of generated thumbnails, as recommended by Exif
+static const int ThumbnailSize = 160;
+static const int ThumbnailQuality = 75;
+
+struct my_error_mgr : public jpeg_error_mgr {
+    jmp_buf setjmp_buffer;
+};
+
+static void my_error_exit (j_common_ptr cinfo)
+{
+    my_error_mgr* myerr = (my_error_mgr*) cinfo->err;
+    longjmp(myerr->setjmp_buffer, 1);
+}
+
+struct thumbnail_destination_mgr : public jpeg_destination_mgr {
+    std::string *data;
+    JOCTET buffer[4096];
+};
+
+static void thumbnail_init_destination(j_compress_ptr cinfo)
+{
+    thumbnail_destination_mgr *dest = (thumbnail_destination_mgr*) cinfo->dest;
+    dest->next_output_byte = dest->buffer;
+    dest->free_in_buffer = sizeof(dest->buffer);
+}
+
+static boolean thumbnail_empty_output_buffer(j_compress_ptr cinfo)
+{
+    thumbnail_destination_mgr *dest = (thumbnail_destination_mgr*) cinfo->dest;
+    dest->data->append((const char*)dest->buffer, sizeof(dest->buffer));
+    dest->next_output_byte = dest->buffer;
+    dest->free_in_buffer = sizeof(dest->buffer);
+    return TRUE;
+}
+
+static void thumbnail_term_destination(j_compress_ptr cinfo)
+{
+    thumbnail_destination_mgr *dest = (thumbnail_destination_mgr*) cinfo->dest;
+    dest->data->append((const char*)dest->buffer,
+                       sizeof(dest->buffer) - dest->free_in_buffer);
+}
+
+struct source_mgr : public jpeg_source_mgr {
+    ByteSource *source;
+    long long position;
+    JOCTET buffer[64 * 1024];
+};
+
+static void source_init_source(j_decompress_ptr)
+{
+}
+
+static boolean source_fill_input_buffer(j_decompress_ptr cinfo)
+{
+    source_mgr *src = (source_mgr*) cinfo->src;
+    long long length = src->source->read((char*)src->buffer,
+                                         sizeof(src->buffer), src->position);
+    // A truncated file ends the image, as with jpeg_stdio_src()
+    if (length <= 0) {
+        src->buffer[0] = 0xff;
+        src->buffer[1] = JPEG_EOI;
+        length = 2;
+    }
+    else
+        src->position += length;
+
+    src->next_input_byte = src->buffer;
+    src->bytes_in_buffer = length;
+    return TRUE;
+}
+
+static void source_skip_input_data(j_decompress_ptr cinfo, long length)
+{
+    source_mgr *src = (source_mgr*) cinfo->src;
+    if (length <= 0)
+        return;
+
+    if ((size_t)length <= src->bytes_in_buffer) {
+        src->next_input_byte += length;
+        src->bytes_in_buffer -= length;
+    }
+    else {
+        src->position += length - src->bytes_in_buffer;
+        src->bytes_in_buffer = 0;
+    }
+}
+
+static void source_term_source(j_decompress_ptr)
+{
+}
+
+struct fd_destination_mgr : public jpeg_destination_mgr {
+    int fd;
+    long long position;
+    JOCTET buffer[64 * 1024];
+};
+
+static void fd_init_destination(j_compress_ptr cinfo)
+{
+    fd_destination_mgr *dest = (fd_destination_mgr*) cinfo->dest;
+    dest->next_output_byte = dest->buffer;
+    dest->free_in_buffer = sizeof(dest->buffer);
+}
+
+static boolean fd_empty_output_buffer(j_compress_ptr cinfo)
+{
+    fd_destination_mgr *dest = (fd_destination_mgr*) cinfo->dest;
+    if (!JpegFile::write(dest->fd, (const char*)dest->buffer,
+                         sizeof(dest->buffer), dest->position))
+        my_error_exit((j_common_ptr) cinfo);
+
+    dest->position += sizeof(dest->buffer);
+    dest->next_output_byte = dest->buffer;
+    dest->free_in_buffer = sizeof(dest->buffer);
+    return TRUE;
+}
+
+static void fd_term_destination(j_compress_ptr cinfo)
+{
+    fd_destination_mgr *dest = (fd_destination_mgr*) cinfo->dest;
+    const size_t size = sizeof(dest->buffer) - dest->free_in_buffer;
+    if (!JpegFile::write(dest->fd, (const char*)dest->buffer, size,
+                         dest->position))
+        my_error_exit((j_common_ptr) cinfo);
+
+    dest->position += size;
+}
+
+std::string ExifWriteback::dcThumbnail(const JpegLibrary *jpeg,
+                                       struct jpeg_decompress_struct *dinfo,
+                                       jvirt_barray_ptr *coefficients)
+{
+    const int components = dinfo->num_components;
+    if (!((dinfo->jpeg_color_space == JCS_GRAYSCALE) && (components == 1)) &&
+        !((dinfo->jpeg_color_space == JCS_YCbCr) && (components == 3)))
+        return std::string();
+
+    // One pixel per 8x8 block of the image, averaged down to the thumbnail
+    const int dcWidth = (dinfo->image_width + DCTSIZE - 1) / DCTSIZE;
+    const int dcHeight = (dinfo->image_height + DCTSIZE - 1) / DCTSIZE;
+    const int scale = std::max(1, (std::max(dcWidth, dcHeight) +
+                                   ThumbnailSize - 1) / ThumbnailSize);
+    const int width = (dcWidth + scale - 1) / scale;
+    const int height = (dcHeight + scale - 1) / scale;
+
+    std::vector<int> sums(width * height * components, 0);
+    std::vector<int> counts(width * height, 0);
+
+    for (int c = 0; c < components; c++) {
+        jpeg_component_info *component = dinfo->comp_info + c;
+        if (!component->quant_table)
+            return std::string();
+        const int quantizer = component->quant_table->quantval[0];
+
+        for (int y = 0; y < dcHeight; y++) {
+            // Subsampled components cover several pixels with one block
+            JDIMENSION blockRow = std::min<JDIMENSION>(
+                y * component->v_samp_factor / dinfo->max_v_samp_factor,
+                component->height_in_blocks - 1);
+            JBLOCKARRAY blocks = (*dinfo->mem->access_virt_barray)
+                ((j_common_ptr) dinfo, coefficients[c], blockRow, 1, FALSE);
+
+            for (int x = 0; x < dcWidth; x++) {
+                JDIMENSION blockColumn = std::min<JDIMENSION>(
+                    x * component->h_samp_factor / dinfo->max_h_samp_factor,
+                    component->width_in_blocks - 1);
+                // The DC coefficient is eight times the mean sample value
+                const int value = blocks[0][blockColumn][0] * quantizer / 8 +
+                    CENTERJSAMPLE;
+                const int pixel = (y / scale) * width + x / scale;
+                sums[pixel * components + c] +=
+                    std::min(std::max(value, 0), MAXJSAMPLE);
+                if (c == 0)
+                    counts[pixel]++;
+            }
+        }
+    }
+
+    std::string result;
+    std::vector<JSAMPLE> line(width * components);
+    thumbnail_destination_mgr dest;
+    dest.data = &result;
+    dest.init_destination = thumbnail_init_destination;
+    dest.empty_output_buffer = thumbnail_empty_output_buffer;
+    dest.term_destination = thumbnail_term_destination;
+
+    struct jpeg_compress_struct cinfo;
+    struct my_error_mgr error;
+    cinfo.err = jpeg->jpeg_std_error(&error);
+    error.error_exit = my_error_exit;
+    jpeg->jpeg_create_compress(&cinfo);
+
+    if (setjmp(error.setjmp_buffer)) {
+        jpeg->jpeg_destroy_compress(&cinfo);
+        return std::string();
+    }
+
+    cinfo.dest = &dest;
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = components;
+    // Samples stay in the color space of the image, no conversion needed
+    cinfo.in_color_space = dinfo->jpeg_color_space;
+    jpeg->jpeg_set_defaults(&cinfo);
+    jpeg->jpeg_set_quality(&cinfo, ThumbnailQuality, TRUE);
+    jpeg->jpeg_start_compress(&cinfo, TRUE);
+
+    for (int y = 0; y < height; y++) {
+        for (int i = 0; i < width * components; i++)
+            line[i] = sums[y * width * components + i] /
+                counts[y * width + i / components];
+        JSAMPROW row = &line[0];
+        jpeg->jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+
+    jpeg->jpeg_finish_compress(&cinfo);
+    jpeg->jpeg_destroy_compress(&cinfo);
+
+    return result;
+}
+
+bool ExifWriteback::writeback(const std::string &fileName,
+                              const std::string &exifSegment,
+                              bool generateThumbnail)
+{
+    // Read and written through the same descriptor
+    const int fd = open(fileName.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    const bool result = writeback(fd, exifSegment, generateThumbnail);
+    close(fd);
+    return result;
+}
+
+bool ExifWriteback::writeback(int fd,
+                              const std::string &exifSegment,
+                              bool generateThumbnail)
+{
+    struct jpeg_decompress_struct dinfo;
+    struct jpeg_compress_struct cinfo;
+    struct my_error_mgr derror, cerror;
+    bool cinfo_inited = false;
+    bool hasError = false;
+    std::string segment = exifSegment;
+
+    const JpegLibrary *jpeg = JpegLibrary::instance();
+    if (!jpeg)
+        return false;
+
+    dinfo.err = jpeg->jpeg_std_error(&derror);
+    derror.error_exit = my_error_exit;
+    jpeg->jpeg_create_decompress(&dinfo);
+
+    FileByteSource input(fd);
+    source_mgr src;
+    src.source = &input;
+    src.position = 0;
+    src.next_input_byte = 0;
+    src.bytes_in_buffer = 0;
+    src.init_source = source_init_source;
+    src.fill_input_buffer = source_fill_input_buffer;
+    src.skip_input_data = source_skip_input_data;
+    src.resync_to_restart = jpeg->jpeg_resync_to_restart;
+    src.term_source = source_term_source;
+    dinfo.src = &src;
+
+    if (!setjmp(derror.setjmp_buffer)) {
+
+        jpeg->jpeg_save_markers(&dinfo, JPEG_COM, 0xFFFF);
+        for (int i=0; i<16; i++)
+            jpeg->jpeg_save_markers(&dinfo, JPEG_APP0+i, 0xFFFF);
+
+        jpeg->jpeg_read_header(&dinfo, true);
+
+        // All of the image is in memory from here on, so the file can
+        // be written over
+        jvirt_barray_ptr *jpegData = jpeg->jpeg_read_coefficients(&dinfo);
+
+        // Without room for the thumbnail, the segment is written as it is
+        if (generateThumbnail && !segment.empty()) {
+            const std::string thumbnail = dcThumbnail(jpeg, &dinfo, jpegData);
+            const std::string patched = thumbnail.empty() ? std::string() :
+                ExifPatcher(segment).patch(
+                    std::map<unsigned int, const ExifEntry*>(), thumbnail);
+            if (!patched.empty())
+                segment = patched;
+        }
+
+        fd_destination_mgr dest;
+        dest.fd = fd;
+        dest.position = 0;
+        dest.init_destination = fd_init_destination;
+        dest.empty_output_buffer = fd_empty_output_buffer;
+        dest.term_destination = fd_term_destination;
+
+        cinfo_inited = true;
+        cinfo.err = jpeg->jpeg_std_error(&cerror);
+        cerror.error_exit = my_error_exit;
+        jpeg->jpeg_create_compress(&cinfo);
+
+        if (!setjmp(cerror.setjmp_buffer)) {
+
+            jpeg->jpeg_copy_critical_parameters(&dinfo, &cinfo);
+            cinfo.dest = &dest;
+
+            jpeg->jpeg_write_coefficients(&cinfo, jpegData);
+
+            if (!segment.empty())
+                jpeg->jpeg_write_marker(&cinfo, JPEG_APP0+1,
+                                        (const JOCTET*)segment.data(),
+                                        segment.size());
+
+            jpeg->jpeg_finish_compress(&cinfo);
+
+            // The new file may be shorter than the old one
+            hasError = (ftruncate(fd, dest.position) != 0);
+        }
+        else
+            hasError = true;
+
+        jpeg->jpeg_finish_decompress(&dinfo);
+    }
+    else
+        hasError = true;
+
+    jpeg->jpeg_destroy_decompress(&dinfo);
+    if (cinfo_inited)
+        jpeg->jpeg_destroy_compress(&cinfo);
+
+    return !hasError;
+}
@@ -0,0 +1,81 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#ifndef EXIF_WRITEBACK_H
+#define EXIF_WRITEBACK_H
+
+#include <string>
+
+struct jpeg_decompress_struct;
+struct jvirt_barray_control;
+class JpegLibrary;
+
+class ExifWriteback
+{
+ public:
+    /*!
+      Replaces the exif segment of the file with a new one.
+
+      If generateThumbnail is set, a thumbnail is built from the DC
+      coefficients of the image, i.e. at 1/8 scale without any inverse
+      DCT, and embedded into IFD1 of the segment.
+     */
+
+    static bool writeback(const std::string &fileName,
+                          const std::string &exifSegment,
+                          bool generateThumbnail = false);
+
+    /*!
+      Replaces the exif segment of an open file, see above. The file is
+      read and written with pread() and pwrite(), so its offset does not
+      matter and is left as it is; it has to be open for reading and
+      writing.
+     */
+
+    static bool writeback(int fd,
+                          const std::string &exifSegment,
+                          bool generateThumbnail = false);
+
+ private:
+    static std::string dcThumbnail(const JpegLibrary *jpeg,
+                                   jpeg_decompress_struct *dinfo,
+                                   jvirt_barray_control **coefficients);
+};
+
+#endif
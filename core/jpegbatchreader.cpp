@@ -0,0 +1,467 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+// Opening and plain reads came with the same kernel release, 5.6
+#if defined(IORING_FEAT_RW_CUR_POS) && defined(__NR_io_uring_setup)
+#define JPEG_BATCH_IO_URING
+#endif
+#endif
+#endif
+
+#include "jpegbatchreader.h"
+#include "jpegfile.h"
+
+struct JpegBatchReader::File
+{
+    enum State {
+        State_Opening,
+        State_Reading,
+        State_Done
+    };
+
+    File(const std::string &name) :
+        name(name), fd(-1), requested(0), headerSize(0),
+        state(State_Opening) {}
+
+    std::string name;
+    int fd;
+    // The beginning of the file, as read so far
+    std::string data;
+    // The size of the last read
+    size_t requested;
+    // Where the image data starts, once known
+    long long headerSize;
+    // The pages which were cached before they were read
+    std::vector<unsigned char> cached;
+    State state;
+};
+
+#ifdef JPEG_BATCH_IO_URING
+
+/*!
+  A minimal io_uring instance, set up through the raw system calls.
+ */
+
+class JpegUring
+{
+ public:
+    JpegUring(unsigned int entries);
+    ~JpegUring();
+
+    bool isValid() const { return m_fd >= 0; }
+
+    /*!
+      Queues a request, to be submitted by the next wait().
+     */
+
+    bool queue(const io_uring_sqe &request);
+
+    /*!
+      Submits the queued requests and waits for at least one completion.
+     */
+
+    bool wait();
+
+    /*!
+      Takes the next completion, returning false if there is none.
+     */
+
+    bool completion(unsigned long long &userData, int &result);
+
+ private:
+    int m_fd;
+    unsigned int m_entries;
+    unsigned int m_queued;
+
+    void *m_sqRing;
+    size_t m_sqRingSize;
+    void *m_cqRing;
+    size_t m_cqRingSize;
+    io_uring_sqe *m_sqes;
+    size_t m_sqesSize;
+
+    unsigned int *m_sqHead;
+    unsigned int *m_sqTail;
+    unsigned int *m_sqMask;
+    unsigned int *m_sqArray;
+    unsigned int *m_cqHead;
+    unsigned int *m_cqTail;
+    unsigned int *m_cqMask;
+    io_uring_cqe *m_cqes;
+};
+
+JpegUring::JpegUring(unsigned int entries) :
+    m_fd(-1), m_entries(0), m_queued(0),
+    m_sqRing(MAP_FAILED), m_sqRingSize(0),
+    m_cqRing(MAP_FAILED), m_cqRingSize(0),
+    m_sqes((io_uring_sqe*)MAP_FAILED), m_sqesSize(0)
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    const int fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0)
+        return;
+
+    if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+        close(fd);
+        return;
+    }
+
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+    m_sqRing = mmap(0, m_sqRingSize, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    m_cqRing = mmap(0, m_cqRingSize, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    m_sqes = (io_uring_sqe*) mmap(0, m_sqesSize, PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if ((m_sqRing == MAP_FAILED) || (m_cqRing == MAP_FAILED) ||
+        (m_sqes == MAP_FAILED)) {
+        close(fd);
+        return;
+    }
+
+    char *sq = (char*) m_sqRing;
+    m_sqHead = (unsigned int*)(sq + params.sq_off.head);
+    m_sqTail = (unsigned int*)(sq + params.sq_off.tail);
+    m_sqMask = (unsigned int*)(sq + params.sq_off.ring_mask);
+    m_sqArray = (unsigned int*)(sq + params.sq_off.array);
+
+    char *cq = (char*) m_cqRing;
+    m_cqHead = (unsigned int*)(cq + params.cq_off.head);
+    m_cqTail = (unsigned int*)(cq + params.cq_off.tail);
+    m_cqMask = (unsigned int*)(cq + params.cq_off.ring_mask);
+    m_cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    m_entries = params.sq_entries;
+    m_fd = fd;
+}
+
+JpegUring::~JpegUring()
+{
+    if (m_sqes != MAP_FAILED)
+        munmap(m_sqes, m_sqesSize);
+    if (m_cqRing != MAP_FAILED)
+        munmap(m_cqRing, m_cqRingSize);
+    if (m_sqRing != MAP_FAILED)
+        munmap(m_sqRing, m_sqRingSize);
+    if (m_fd >= 0)
+        close(m_fd);
+}
+
+bool JpegUring::queue(const io_uring_sqe &request)
+{
+    // Only this thread moves the tail, the kernel moves the head
+    const unsigned int tail = *m_sqTail;
+    if (tail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) >= m_entries)
+        return false;
+
+    const unsigned int index = tail & *m_sqMask;
+    m_sqes[index] = request;
+    m_sqArray[index] = index;
+    __atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+    m_queued++;
+    return true;
+}
+
+bool JpegUring::wait()
+{
+    for (;;) {
+        const int result = syscall(__NR_io_uring_enter, m_fd, m_queued, 1,
+                                   IORING_ENTER_GETEVENTS, 0, 0);
+        if (result >= 0) {
+            m_queued -= std::min<unsigned int>(result, m_queued);
+            return true;
+        }
+        if ((errno != EINTR) && (errno != EAGAIN) && (errno != EBUSY))
+            return false;
+    }
+}
+
+bool JpegUring::completion(unsigned long long &userData, int &result)
+{
+    const unsigned int head = *m_cqHead;
+    if (head == __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE))
+        return false;
+
+    const io_uring_cqe &cqe = m_cqes[head & *m_cqMask];
+    userData = cqe.user_data;
+    result = cqe.res;
+    __atomic_store_n(m_cqHead, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+#endif // JPEG_BATCH_IO_URING
+
+JpegBatchReader::JpegBatchReader(int queueDepth, size_t initialSize) :
+    m_queueDepth(std::max(queueDepth, 1)),
+    m_initialSize(std::max<size_t>(initialSize, 1))
+{
+}
+
+std::vector<JpegHeader>
+JpegBatchReader::read(const std::vector<std::string> &fileNames) const
+{
+    std::vector<File> files(fileNames.begin(), fileNames.end());
+
+    if (!readAsynchronously(files))
+        for (size_t i = 0; i < files.size(); i++)
+            if (files[i].state != File::State_Done)
+                readSynchronously(files[i]);
+
+    std::vector<JpegHeader> headers;
+    headers.reserve(files.size());
+    for (size_t i = 0; i < files.size(); i++)
+        headers.push_back(JpegHeader(files[i].data.data(),
+                                     files[i].data.size()));
+    return headers;
+}
+
+size_t JpegBatchReader::nextReadSize(File &file, size_t lastRead) const
+{
+    file.headerSize = file.data.size();
+
+    const JpegHeader header(file.data.data(), file.data.size());
+    if (header.isComplete())
+        file.headerSize = header.requiredSize();
+
+    // The end of the file
+    if (lastRead < file.requested)
+        return 0;
+
+    if (!header.isValid() || header.isComplete() ||
+        (header.requiredSize() <= (long long)file.data.size()))
+        return 0;
+
+    return std::max<size_t>(header.requiredSize() - file.data.size(),
+                            JpegFile::ReadSize);
+}
+
+void JpegBatchReader::finish(File &file) const
+{
+    if (file.fd >= 0) {
+        JpegFile::release(file.fd, file.headerSize, file.data.size(),
+                          file.cached);
+        close(file.fd);
+    }
+    file.fd = -1;
+    file.state = File::State_Done;
+}
+
+void JpegBatchReader::readSynchronously(File &file) const
+{
+    // Start over from whatever an interrupted asynchronous read left
+    if (file.fd >= 0)
+        close(file.fd);
+    file.data.clear();
+    file.requested = 0;
+    file.headerSize = 0;
+    file.cached.clear();
+
+    file.fd = JpegFile::open(file.name);
+    if (file.fd < 0) {
+        finish(file);
+        return;
+    }
+
+    size_t size = m_initialSize;
+    while (size > 0) {
+        const size_t offset = file.data.size();
+        file.data.resize(offset + size);
+        file.requested = size;
+
+        JpegFile::noteCachedPages(file.fd, offset, size, file.cached);
+        const long long result = JpegFile::read(file.fd, &file.data[offset],
+                                                size, offset);
+        file.data.resize(offset + std::max(result, 0LL));
+        size = (result > 0) ? nextReadSize(file, result) : 0;
+    }
+
+    finish(file);
+}
+
+#ifdef JPEG_BATCH_IO_URING
+
+static io_uring_sqe readRequest(size_t index, int fd, std::string &data,
+                                size_t offset, size_t size)
+{
+    io_uring_sqe request;
+    memset(&request, 0, sizeof(request));
+    request.opcode = IORING_OP_READ;
+    request.fd = fd;
+    request.addr = (unsigned long long)(data.data() + offset);
+    request.len = size;
+    request.off = offset;
+    request.user_data = index;
+    return request;
+}
+
+// Marks the completions of cancel requests, as opposed to file indices
+static const unsigned long long CancelRequest = 1ULL << 63;
+
+static io_uring_sqe cancelRequest(size_t index)
+{
+    io_uring_sqe request;
+    memset(&request, 0, sizeof(request));
+    request.opcode = IORING_OP_ASYNC_CANCEL;
+    request.fd = -1;
+    request.addr = index;
+    request.user_data = index | CancelRequest;
+    return request;
+}
+
+bool JpegBatchReader::readAsynchronously(std::vector<File> &files) const
+{
+    JpegUring ring(m_queueDepth);
+    if (!ring.isValid())
+        return false;
+
+    size_t next = 0;
+    int inFlight = 0;
+    while ((next < files.size()) || (inFlight > 0)) {
+        // Keep the queue full with new files
+        for (; (next < files.size()) && (inFlight < m_queueDepth); next++) {
+            io_uring_sqe request;
+            memset(&request, 0, sizeof(request));
+            request.opcode = IORING_OP_OPENAT;
+            request.fd = AT_FDCWD;
+            request.addr = (unsigned long long) files[next].name.c_str();
+            request.open_flags = O_RDONLY | O_CLOEXEC;
+            request.user_data = next;
+            if (!ring.queue(request))
+                break;
+            inFlight++;
+        }
+
+        unsigned long long index;
+        int result;
+        if (!ring.wait()) {
+            // The requests in flight point into the files: cancel them,
+            // and wait for all of them before the ring and buffers go
+            for (size_t i = 0; i < next; i++)
+                if (files[i].state != File::State_Done)
+                    ring.queue(cancelRequest(i));
+            while ((inFlight > 0) && ring.wait())
+                while (ring.completion(index, result)) {
+                    if (index & CancelRequest)
+                        continue;
+                    if ((files[index].state == File::State_Opening) &&
+                        (result >= 0))
+                        files[index].fd = result;
+                    inFlight--;
+                }
+
+            // The kernel may still write into the buffers of requests
+            // which could not be waited for, so they are left allocated
+            // and the files are read again from copies
+            if (inFlight > 0) {
+                std::vector<File> *orphans = new std::vector<File>;
+                orphans->swap(files);
+                files = *orphans;
+            }
+            return false;
+        }
+
+        while (ring.completion(index, result)) {
+            File &file = files[index];
+            size_t size = 0;
+
+            if (file.state == File::State_Opening) {
+                if (result >= 0) {
+                    file.fd = result;
+                    file.state = File::State_Reading;
+                    JpegFile::advise(file.fd);
+                    size = m_initialSize;
+                }
+            }
+            else {
+                const size_t offset = file.data.size() - file.requested;
+                file.data.resize(offset + std::max(result, 0));
+                size = (result > 0) ? nextReadSize(file, result) : 0;
+            }
+
+            if (size > 0) {
+                const size_t offset = file.data.size();
+                file.data.resize(offset + size);
+                file.requested = size;
+                JpegFile::noteCachedPages(file.fd, offset, size, file.cached);
+                // There is room, as each file has one request at most
+                ring.queue(readRequest(index, file.fd, file.data, offset, size));
+                continue;
+            }
+
+            finish(file);
+            inFlight--;
+        }
+    }
+    return true;
+}
+
+bool JpegBatchReader::isAsynchronous()
+{
+    static const bool isSupported = JpegUring(1).isValid();
+    return isSupported;
+}
+
+#else
+
+bool JpegBatchReader::readAsynchronously(std::vector<File> &) const
+{
+    return false;
+}
+
+bool JpegBatchReader::isAsynchronous()
+{
+    return false;
+}
+
+#endif // JPEG_BATCH_IO_URING
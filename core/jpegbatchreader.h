@@ -0,0 +1,103 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#ifndef JPEG_BATCH_READER_H
+#define JPEG_BATCH_READER_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "jpegheader.h"
+
+/*!
+  Reads the headers of many JPEG files at once.
+
+  The first bytes of each file are read, and the read is only extended
+  when the marker walk shows segments beyond what was read. With
+  io_uring, the files are opened and read with many requests in flight,
+  which keeps fast and remote storage busy; elsewhere, the files are
+  read one after the other with pread().
+ */
+
+class JpegBatchReader
+{
+ public:
+    /*!
+      @param queueDepth How many files are read at the same time.
+
+      @param initialSize How much of each file is read at first, which
+      covers the header of most camera images.
+     */
+
+    explicit JpegBatchReader(int queueDepth = 32,
+                             size_t initialSize = 64 * 1024);
+
+    /*!
+      Reads the headers of the given files, with the payloads of all
+      segments. The headers are given in the order of the files; a file
+      which could not be read has an invalid header.
+     */
+
+    std::vector<JpegHeader> read(const std::vector<std::string> &fileNames) const;
+
+    /*!
+      Returns true if the files are read through io_uring, i.e. the
+      library was built with it and the kernel supports it.
+     */
+
+    static bool isAsynchronous();
+
+ private:
+    struct File;
+
+    bool readAsynchronously(std::vector<File> &files) const;
+
+    void readSynchronously(File &file) const;
+
+    size_t nextReadSize(File &file, size_t lastRead) const;
+
+    void finish(File &file) const;
+
+ private:
+    int m_queueDepth;
+    size_t m_initialSize;
+};
+
+#endif
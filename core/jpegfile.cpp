@@ -0,0 +1,159 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <algorithm>
+
+#include "jpegfile.h"
+
+const size_t JpegFile::InitialReadSize;
+const size_t JpegFile::ReadSize;
+
+int JpegFile::open(const std::string &fileName)
+{
+    int fd;
+    do {
+        fd = ::open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+    } while ((fd < 0) && (errno == EINTR));
+
+    if (fd >= 0)
+        advise(fd);
+    return fd;
+}
+
+void JpegFile::advise(int fd)
+{
+#ifdef POSIX_FADV_RANDOM
+    // The reads are few and sized to the header; read-ahead, even the
+    // larger one of sequential access, would only bring in image data
+    posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+#endif
+#ifdef POSIX_FADV_NOREUSE
+    posix_fadvise(fd, 0, 0, POSIX_FADV_NOREUSE);
+#endif
+}
+
+long long JpegFile::read(int fd, char *data, size_t size, long long position)
+{
+    size_t done = 0;
+    while (done < size) {
+        const ssize_t result = pread(fd, data + done, size - done,
+                                     position + done);
+        if (result < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (result == 0)
+            break;
+        done += result;
+    }
+    return done;
+}
+
+bool JpegFile::write(int fd, const char *data, size_t size, long long position)
+{
+    while (size > 0) {
+        const ssize_t result = pwrite(fd, data, size, position);
+        if (result < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += result;
+        size -= result;
+        position += result;
+    }
+    return true;
+}
+
+void JpegFile::noteCachedPages(int fd, long long position, size_t size,
+                               std::vector<unsigned char> &cached)
+{
+    const long long pageSize = sysconf(_SC_PAGESIZE);
+    const long long end = (position + size + pageSize - 1) / pageSize;
+    const long long first = std::max<long long>(position / pageSize,
+                                                cached.size());
+    if ((position < 0) || (first >= end))
+        return;
+    cached.resize(end, 1);
+
+    // A mapping which is never touched tells what is in the cache
+    // without bringing anything in
+    const size_t mapSize = (end - first) * pageSize;
+    void *map = mmap(0, mapSize, PROT_READ, MAP_SHARED, fd, first * pageSize);
+    if (map == MAP_FAILED)
+        return;
+    std::vector<unsigned char> resident(end - first);
+    if (mincore(map, mapSize, &resident[0]) == 0)
+        for (long long page = first; page < end; page++)
+            cached[page] = resident[page - first] & 1;
+    munmap(map, mapSize);
+}
+
+void JpegFile::release(int fd, long long headerSize, long long readSize,
+                       const std::vector<unsigned char> &cached)
+{
+#ifdef POSIX_FADV_DONTNEED
+    // The page holding the end of the header is kept
+    const long long pageSize = sysconf(_SC_PAGESIZE);
+    const long long end = std::min<long long>((readSize + pageSize - 1) / pageSize,
+                                              cached.size());
+    long long page = (headerSize + pageSize - 1) / pageSize;
+    while (page < end) {
+        if (cached[page]) {
+            page++;
+            continue;
+        }
+        const long long first = page;
+        while ((page < end) && !cached[page])
+            page++;
+        posix_fadvise(fd, first * pageSize, (page - first) * pageSize,
+                      POSIX_FADV_DONTNEED);
+    }
+#else
+    (void)fd;
+    (void)headerSize;
+    (void)readSize;
+    (void)cached;
+#endif
+}
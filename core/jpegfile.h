@@ -0,0 +1,127 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#ifndef JPEG_FILE_H
+#define JPEG_FILE_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+/*!
+  Reads the header of a JPEG file without dragging its image data
+  through the page cache.
+
+  The header is read with pread() in a few large reads rather than
+  through stdio, and the kernel is told not to read ahead, so that
+  indexing a large, cold collection of images leaves the cache of
+  other processes alone.
+ */
+
+class JpegFile
+{
+ public:
+    // The first read, which covers the header of most camera images
+    static const size_t InitialReadSize = 64 * 1024;
+
+    // Later reads, as segments usually follow each other
+    static const size_t ReadSize = 16 * 1024;
+
+    /*!
+      Opens a file for reading its header, and gives the hints of
+      advise().
+
+      @return the file descriptor, or -1 on failure.
+     */
+
+    static int open(const std::string &fileName);
+
+    /*!
+      Tells the kernel that only what is explicitly read is needed,
+      and only once.
+     */
+
+    static void advise(int fd);
+
+    /*!
+      Reads from a given position, retrying when interrupted.
+
+      @return the number of bytes read, which is less than the size
+      only at the end of the file, or -1 on failure.
+     */
+
+    static long long read(int fd, char *data, size_t size,
+                          long long position);
+
+    /*!
+      Writes at a given position, retrying when interrupted.
+     */
+
+    static bool write(int fd, const char *data, size_t size,
+                      long long position);
+
+    /*!
+      Notes which pages of a range are in the page cache before the
+      range is read, so that release() leaves them there. Pages noted
+      by an earlier call are not noted again.
+
+      @param cached One entry per page of the file, nonzero if the page
+      was cached; pages which cannot be checked count as cached.
+     */
+
+    static void noteCachedPages(int fd, long long position, size_t size,
+                                std::vector<unsigned char> &cached);
+
+    /*!
+      Drops from the page cache what was read past the end of the
+      header, i.e. the beginning of the image data, if the read brought
+      it in. Pages that some other reader had cached are kept.
+
+      @param headerSize Where the image data starts.
+
+      @param readSize How much of the file was read.
+
+      @param cached The pages noted by noteCachedPages() before reading.
+     */
+
+    static void release(int fd, long long headerSize, long long readSize,
+                        const std::vector<unsigned char> &cached);
+};
+
+#endif
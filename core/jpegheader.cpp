@@ -0,0 +1,432 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#include <string.h>
+#include <algorithm>
+
+#include "jpegheader.h"
+#include "jpegfile.h"
+#include "bytesource.h"
+
+// Enough to tell the segments of the same type apart
+static const int SignatureLength = 32;
+
+/*!
+  Where the header is read from.
+ */
+
+class JpegInput
+{
+ public:
+    virtual ~JpegInput() {}
+
+    virtual bool getChar(unsigned char &c) = 0;
+    virtual size_t read(char *data, size_t size) = 0;
+    virtual bool skip(size_t size) = 0;
+    virtual long long pos() const = 0;
+};
+
+class JpegSourceInput : public JpegInput
+{
+ public:
+    JpegSourceInput(ByteSource &source) :
+        m_source(source), m_start(0), m_pos(0), m_readSize(0)
+    {
+        const size_t hint = source.readSizeHint();
+        m_initialReadSize = hint ? hint : JpegFile::InitialReadSize;
+        m_chunkSize = hint ? hint : JpegFile::ReadSize;
+    }
+
+    bool getChar(unsigned char &c)
+    {
+        if (!fill())
+            return false;
+        c = m_buffer[m_pos++ - m_start];
+        return true;
+    }
+
+    size_t read(char *data, size_t size)
+    {
+        size_t done = 0;
+        while (done < size) {
+            const size_t left = size - done;
+
+            // Large payloads are read in place
+            if (!isBuffered() && (left > m_chunkSize)) {
+                const long long result = m_source.read(data + done, left, m_pos);
+                if (result <= 0)
+                    break;
+                m_pos += result;
+                m_readSize = std::max(m_readSize, m_pos);
+                done += result;
+                continue;
+            }
+
+            if (!fill())
+                break;
+            const size_t length =
+                std::min<long long>(left, m_start + m_buffer.size() - m_pos);
+            memcpy(data + done, m_buffer.data() + (m_pos - m_start), length);
+            m_pos += length;
+            done += length;
+        }
+        return done;
+    }
+
+    bool skip(size_t size)
+    {
+        m_pos += size;
+        return true;
+    }
+
+    long long pos() const
+    {
+        return m_pos;
+    }
+
+    /*!
+      Returns how much of the source was read, including what was read
+      ahead of the current position.
+     */
+
+    long long readSize() const
+    {
+        return m_readSize;
+    }
+
+ private:
+    bool isBuffered() const
+    {
+        return (m_pos >= m_start) &&
+            (m_pos < m_start + (long long)m_buffer.size());
+    }
+
+    bool fill()
+    {
+        if (isBuffered())
+            return true;
+
+        m_buffer.resize((m_readSize == 0) ? m_initialReadSize : m_chunkSize);
+        const long long result = m_source.read(&m_buffer[0], m_buffer.size(),
+                                               m_pos);
+        m_buffer.resize(std::max(result, 0LL));
+        m_start = m_pos;
+        m_readSize = std::max(m_readSize, m_pos + (long long)m_buffer.size());
+        return !m_buffer.empty();
+    }
+
+    ByteSource &m_source;
+    size_t m_initialReadSize;
+    size_t m_chunkSize;
+    // What was read last, starting from m_start in the source
+    std::string m_buffer;
+    long long m_start;
+    long long m_pos;
+    long long m_readSize;
+};
+
+class JpegMemoryInput : public JpegInput
+{
+ public:
+    JpegMemoryInput(const char *data, size_t size) :
+        m_data(data), m_size(size), m_pos(0) {}
+
+    bool getChar(unsigned char &c)
+    {
+        if (m_pos >= m_size)
+            return false;
+        c = m_data[m_pos++];
+        return true;
+    }
+
+    size_t read(char *data, size_t size)
+    {
+        size = std::min(size, m_size - m_pos);
+        memcpy(data, m_data + m_pos, size);
+        m_pos += size;
+        return size;
+    }
+
+    bool skip(size_t size)
+    {
+        if (size > m_size - m_pos)
+            return false;
+        m_pos += size;
+        return true;
+    }
+
+    long long pos() const
+    {
+        return m_pos;
+    }
+
+ private:
+    const char *m_data;
+    size_t m_size;
+    size_t m_pos;
+};
+
+JpegFrame::JpegFrame() :
+    width(0), height(0), components(0), isProgressive(false)
+{
+}
+
+bool JpegFrame::isValid() const
+{
+    return (components > 0) && (width > 0) && (height > 0);
+}
+
+JpegHeader::JpegHeader(const std::string &fileName, ReadMode mode) :
+    m_isValid(false), m_isComplete(false), m_requiredSize(0)
+{
+    FileByteSource source(fileName);
+    if (source.isOpen())
+        read(source, mode);
+}
+
+JpegHeader::JpegHeader(ByteSource &source, ReadMode mode) :
+    m_isValid(false), m_isComplete(false), m_requiredSize(0)
+{
+    read(source, mode);
+}
+
+JpegHeader::JpegHeader(const char *data, size_t size) :
+    m_isValid(false), m_isComplete(false), m_requiredSize(0)
+{
+    JpegMemoryInput input(data, size);
+    m_isValid = read(input, ReadMode_Payloads);
+}
+
+bool JpegHeader::isValid() const
+{
+    return m_isValid;
+}
+
+bool JpegHeader::isComplete() const
+{
+    return m_isComplete;
+}
+
+long long JpegHeader::requiredSize() const
+{
+    return m_requiredSize;
+}
+
+std::string JpegHeader::segment(Marker marker, const std::string &signature) const
+{
+    const int index = indexOf(marker, signature);
+    if (index < 0)
+        return std::string();
+
+    const Segment &segment = m_segments[index];
+    if (segment.loaded < segment.size)
+        return std::string();
+
+    return m_data.substr(segment.offset, segment.size);
+}
+
+long long JpegHeader::position(Marker marker, const std::string &signature) const
+{
+    const int index = indexOf(marker, signature);
+    return (index < 0) ? -1 : m_segments[index].position;
+}
+
+int JpegHeader::size(Marker marker, const std::string &signature) const
+{
+    const int index = indexOf(marker, signature);
+    return (index < 0) ? -1 : m_segments[index].size;
+}
+
+int JpegHeader::indexOf(Marker marker, const std::string &signature) const
+{
+    for (size_t i = 0; i < m_segments.size(); i++) {
+        const Segment &segment = m_segments[i];
+        if ((segment.marker == marker) &&
+            (segment.loaded >= (int)signature.size()) &&
+            (m_data.compare(segment.offset, signature.size(), signature) == 0))
+            return i;
+    }
+    return -1;
+}
+
+bool JpegHeader::readPayloads(const std::string &fileName)
+{
+    // The file is not opened if all payloads are there already
+    for (size_t i = 0; i < m_segments.size(); i++)
+        if (m_segments[i].loaded < m_segments[i].size) {
+            FileByteSource source(fileName);
+            return source.isOpen() && readPayloads(source);
+        }
+    return true;
+}
+
+bool JpegHeader::readPayloads(ByteSource &source)
+{
+    bool result = true;
+
+    // A segment cut short by the end of the file stays unread
+    for (size_t i = 0; i < m_segments.size(); i++) {
+        Segment &segment = m_segments[i];
+        if (segment.loaded == segment.size)
+            continue;
+
+        std::string payload(segment.size, '\0');
+        if (source.read(&payload[0], segment.size, segment.position) !=
+            segment.size) {
+            result = false;
+            continue;
+        }
+
+        segment.offset = m_data.size();
+        segment.loaded = segment.size;
+        m_data.append(payload);
+    }
+
+    return result;
+}
+
+bool JpegHeader::isFrameMarker(int marker)
+{
+    // SOF0 to SOF15, except for DHT, JPG and DAC sharing the range
+    return (marker >= 0xc0) && (marker <= 0xcf) &&
+        (marker != 0xc4) && (marker != 0xc8) && (marker != 0xcc);
+}
+
+JpegFrame JpegHeader::frame() const
+{
+    for (size_t s = 0; s < m_segments.size(); s++) {
+        const Segment &segment = m_segments[s];
+        if (!isFrameMarker(segment.marker))
+            continue;
+
+        // Precision, height, width and the number of components,
+        // followed by three bytes per component
+        const unsigned char *data =
+            (const unsigned char*)m_data.data() + segment.offset;
+        if ((segment.size < 6) || (segment.size < 6 + 3 * data[5]))
+            return JpegFrame();
+
+        JpegFrame frame;
+        frame.width = (data[3] << 8) | data[4];
+        frame.height = (data[1] << 8) | data[2];
+        frame.components = data[5];
+        frame.isProgressive = ((segment.marker & 0x3) == 0x2);
+        for (int i = 0; i < frame.components; i++) {
+            const unsigned char sampling = data[6 + 3 * i + 1];
+            JpegFrame::SamplingFactor factor;
+            factor.horizontal = sampling >> 4;
+            factor.vertical = sampling & 0xf;
+            frame.samplingFactors.push_back(factor);
+        }
+        return frame;
+    }
+    return JpegFrame();
+}
+
+void JpegHeader::read(ByteSource &source, ReadMode mode)
+{
+    JpegSourceInput input(source);
+    m_isValid = read(input, mode);
+    if (input.readSize() > input.pos())
+        source.release(input.pos(), input.readSize() - input.pos());
+}
+
+bool JpegHeader::read(JpegInput &input, ReadMode mode)
+{
+    unsigned char c;
+    if (!input.getChar(c) || (c != 0xff) ||
+        !input.getChar(c) || (c != Marker_SOI))
+        return false;
+
+    // A truncated or corrupt header still gives the segments before it;
+    // the next marker and its length are needed to go on
+    const int markerLength = 4;
+    for (;;) {
+        m_requiredSize = input.pos() + markerLength;
+        if (!input.getChar(c) || (c != 0xff))
+            return true;
+
+        // Markers may be preceded by any number of fill bytes
+        do {
+            if (!input.getChar(c))
+                return true;
+        } while (c == 0xff);
+
+        const int marker = c;
+        if ((marker == Marker_SOS) || (marker == Marker_EOI)) {
+            m_requiredSize = input.pos();
+            m_isComplete = true;
+            return true;
+        }
+
+        // TEM and RSTn have no payload
+        if ((marker == 0x01) || ((marker >= 0xd0) && (marker <= 0xd7)))
+            continue;
+
+        unsigned char length[2];
+        if (input.read((char*)length, 2) != 2)
+            return true;
+
+        Segment segment;
+        segment.marker = marker;
+        segment.position = input.pos();
+        segment.offset = m_data.size();
+        segment.size = ((length[0] << 8) | length[1]) - 2;
+        if (segment.size < 0)
+            return true;
+        m_requiredSize = segment.position + segment.size + markerLength;
+
+        // Frame headers are small and always needed
+        segment.loaded = ((mode == ReadMode_Payloads) || isFrameMarker(marker)) ?
+            segment.size : std::min(segment.size, SignatureLength);
+
+        m_data.resize(segment.offset + segment.loaded);
+        if ((segment.loaded > 0) &&
+            (input.read(&m_data[segment.offset], segment.loaded) !=
+             (size_t)segment.loaded)) {
+            m_data.resize(segment.offset);
+            return true;
+        }
+        if ((segment.loaded < segment.size) &&
+            !input.skip(segment.size - segment.loaded))
+            return true;
+
+        m_segments.push_back(segment);
+    }
+}
@@ -0,0 +1,216 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#ifndef JPEG_HEADER_H
+#define JPEG_HEADER_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+class JpegInput;
+class ByteSource;
+
+/*!
+  The frame parameters of a JPEG image, as given by its start of frame
+  segment.
+ */
+
+struct JpegFrame
+{
+    struct SamplingFactor {
+        int horizontal;
+        int vertical;
+    };
+
+    JpegFrame();
+
+    bool isValid() const;
+
+    // Pixel dimensions
+    int width;
+    int height;
+    int components;
+    // Progressive rather than sequential coding
+    bool isProgressive;
+    // Sampling factors of each component
+    std::vector<SamplingFactor> samplingFactors;
+};
+
+/*!
+  The marker segments of a JPEG file, up to the start of the first scan.
+
+  The header is read in a single pass without touching the entropy
+  coded data, so that all metadata blocks can be found at the cost of
+  reading the file once.
+ */
+
+class JpegHeader
+{
+ public:
+    enum Marker {
+        Marker_SOI = 0xd8,
+        Marker_EOI = 0xd9,
+        Marker_SOS = 0xda,
+        Marker_APP0 = 0xe0,
+        Marker_APP1 = 0xe1,
+        Marker_APP2 = 0xe2,
+        Marker_APP13 = 0xed
+    };
+
+    enum ReadMode {
+        //! Read the payloads of all segments
+        ReadMode_Payloads,
+        //! Read the frame header and the first bytes of other segments,
+        //! enough to tell them apart, and skip over the rest
+        ReadMode_Structure
+    };
+
+    JpegHeader(const std::string &fileName, ReadMode mode = ReadMode_Payloads);
+
+    /*!
+      Reads the header of a JPEG image from a byte source, in as few
+      reads as its readSizeHint() allows. What was read past the header
+      is released from the source.
+     */
+
+    explicit JpegHeader(ByteSource &source, ReadMode mode = ReadMode_Payloads);
+
+    /*!
+      Reads the header of a JPEG image in memory, e.g. of an embedded
+      thumbnail.
+     */
+
+    JpegHeader(const char *data, size_t size);
+
+    /*!
+      Returns true if the file starts like a JPEG file.
+     */
+
+    bool isValid() const;
+
+    /*!
+      Returns true if the header was read up to the start of the first
+      scan or the end of the image, rather than cut short by the end of
+      the data.
+     */
+
+    bool isComplete() const;
+
+    /*!
+      For a header cut short, returns how long a prefix of the file is
+      needed to read on: up to the end of the segment which was cut,
+      and the marker and length of the next one. For a complete header,
+      returns its size, i.e. where the image data starts.
+     */
+
+    long long requiredSize() const;
+
+    /*!
+      Returns the payload of the first segment with the given marker
+      whose payload starts with the given signature, or an empty string
+      if there is no such segment.
+     */
+
+    std::string segment(Marker marker, const std::string &signature) const;
+
+    /*!
+      Returns the position in the file of the payload of a segment, as
+      found by segment(), or -1 if there is no such segment.
+     */
+
+    long long position(Marker marker, const std::string &signature) const;
+
+    /*!
+      Returns the payload size of a segment, as found by segment(), or
+      -1 if there is no such segment.
+     */
+
+    int size(Marker marker, const std::string &signature) const;
+
+    /*!
+      Reads the payloads skipped in ReadMode_Structure from the file,
+      without scanning the header again.
+     */
+
+    bool readPayloads(const std::string &fileName);
+
+    /*!
+      Reads the payloads skipped in ReadMode_Structure from a byte
+      source, see above.
+     */
+
+    bool readPayloads(ByteSource &source);
+
+    /*!
+      Returns the frame parameters of the image, or an invalid frame if
+      the header has no valid start of frame segment.
+     */
+
+    JpegFrame frame() const;
+
+ private:
+    void read(ByteSource &source, ReadMode mode);
+    bool read(JpegInput &input, ReadMode mode);
+
+    int indexOf(Marker marker, const std::string &signature) const;
+
+    static bool isFrameMarker(int marker);
+
+ private:
+    struct Segment {
+        int marker;
+        // Position of the payload in the file
+        long long position;
+        // Position of the payload in m_data
+        size_t offset;
+        int size;
+        // How much of the payload has been read
+        int loaded;
+    };
+
+    // Segment payloads or their beginnings, back to back
+    std::string m_data;
+    std::vector<Segment> m_segments;
+    bool m_isValid;
+    bool m_isComplete;
+    long long m_requiredSize;
+};
+
+#endif
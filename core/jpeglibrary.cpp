@@ -0,0 +1,98 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#include <dlfcn.h>
+#include "jpeglibrary.h"
+
+JpegLibrary::JpegLibrary()
+{
+}
+
+const JpegLibrary *JpegLibrary::instance()
+{
+    // Loaded at most once; a failed load is not retried
+    static JpegLibrary library;
+    static const bool isLoaded = library.load();
+
+    return isLoaded ? &library : 0;
+}
+
+#define RESOLVE(function)                                               \
+    if (!(function = (__typeof__(function)) dlsym(handle, #function)))  \
+        return false;
+
+bool JpegLibrary::load()
+{
+    // The soname follows the ABI version the headers were built for:
+    // libjpeg.so.62 for 6b, libjpeg.so.8 for 8 and so on
+    char soname[32];
+#if JPEG_LIB_VERSION >= 70
+    snprintf(soname, sizeof(soname), "libjpeg.so.%d", JPEG_LIB_VERSION / 10);
+#else
+    snprintf(soname, sizeof(soname), "libjpeg.so.%d", JPEG_LIB_VERSION);
+#endif
+
+    // The library stays loaded for the lifetime of the process
+    void *handle = dlopen(soname, RTLD_NOW | RTLD_LOCAL);
+    if (!handle)
+        return false;
+
+    RESOLVE(jpeg_std_error);
+    RESOLVE(jpeg_CreateCompress);
+    RESOLVE(jpeg_CreateDecompress);
+    RESOLVE(jpeg_destroy_compress);
+    RESOLVE(jpeg_destroy_decompress);
+    RESOLVE(jpeg_save_markers);
+    RESOLVE(jpeg_read_header);
+    RESOLVE(jpeg_read_coefficients);
+    RESOLVE(jpeg_resync_to_restart);
+    RESOLVE(jpeg_finish_decompress);
+    RESOLVE(jpeg_set_defaults);
+    RESOLVE(jpeg_set_quality);
+    RESOLVE(jpeg_start_compress);
+    RESOLVE(jpeg_write_scanlines);
+    RESOLVE(jpeg_copy_critical_parameters);
+    RESOLVE(jpeg_write_coefficients);
+    RESOLVE(jpeg_write_marker);
+    RESOLVE(jpeg_finish_compress);
+
+    return true;
+}
+
+#undef RESOLVE
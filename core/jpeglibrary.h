@@ -0,0 +1,94 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#ifndef JPEG_LIBRARY_H
+#define JPEG_LIBRARY_H
+
+extern "C" {
+#include <stdio.h>
+#include <jpeglib.h>
+}
+
+/*!
+  The libjpeg functions used by ExifWriteback, resolved from the library
+  the first time a file is written. Reading metadata never needs libjpeg,
+  so it is not loaded at all by processes which only read.
+
+  The members have the names and types of the libjpeg functions, so the
+  jpeglib.h macros work through them, as in jpeg->jpeg_create_compress().
+ */
+
+class JpegLibrary
+{
+ public:
+
+    /*!
+      Loads libjpeg on the first call.
+
+      @return the loaded library, or 0 if libjpeg is not available.
+     */
+
+    static const JpegLibrary *instance();
+
+    __typeof__(&::jpeg_std_error) jpeg_std_error;
+    __typeof__(&::jpeg_CreateCompress) jpeg_CreateCompress;
+    __typeof__(&::jpeg_CreateDecompress) jpeg_CreateDecompress;
+    __typeof__(&::jpeg_destroy_compress) jpeg_destroy_compress;
+    __typeof__(&::jpeg_destroy_decompress) jpeg_destroy_decompress;
+    __typeof__(&::jpeg_save_markers) jpeg_save_markers;
+    __typeof__(&::jpeg_read_header) jpeg_read_header;
+    __typeof__(&::jpeg_read_coefficients) jpeg_read_coefficients;
+    __typeof__(&::jpeg_resync_to_restart) jpeg_resync_to_restart;
+    __typeof__(&::jpeg_finish_decompress) jpeg_finish_decompress;
+    __typeof__(&::jpeg_set_defaults) jpeg_set_defaults;
+    __typeof__(&::jpeg_set_quality) jpeg_set_quality;
+    __typeof__(&::jpeg_start_compress) jpeg_start_compress;
+    __typeof__(&::jpeg_write_scanlines) jpeg_write_scanlines;
+    __typeof__(&::jpeg_copy_critical_parameters) jpeg_copy_critical_parameters;
+    __typeof__(&::jpeg_write_coefficients) jpeg_write_coefficients;
+    __typeof__(&::jpeg_write_marker) jpeg_write_marker;
+    __typeof__(&::jpeg_finish_compress) jpeg_finish_compress;
+
+ private:
+    JpegLibrary();
+
+    bool load();
+};
+
+#endif
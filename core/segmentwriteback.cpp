@@ -0,0 +1,111 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#include <unistd.h>
+#include <algorithm>
+
+#include "segmentwriteback.h"
+#include "jpegheader.h"
+#include "jpegfile.h"
+#include "bytesource.h"
+
+// The length field counts itself
+static const size_t MaxPayloadSize = 0xffff - 2;
+
+bool SegmentWriteback::writeback(int fd, int marker,
+                                 const std::string &signature,
+                                 const std::string &payload)
+{
+    if (payload.size() > MaxPayloadSize)
+        return false;
+
+    FileByteSource source(fd);
+    const long long size = source.size();
+    if (size < 0)
+        return false;
+
+    std::string data(size, '\0');
+    if (source.read(&data[0], size, 0) != size)
+        return false;
+
+    const JpegHeader header(data.data(), data.size());
+    if (!header.isValid())
+        return false;
+
+    // Positions are those of the payloads, after the marker and length
+    const int segmentHeaderSize = 4;
+    long long begin = header.position((JpegHeader::Marker) marker, signature);
+    long long end;
+    if (begin >= 0) {
+        end = begin + header.size((JpegHeader::Marker) marker, signature);
+        begin -= segmentHeaderSize;
+    }
+    else {
+        // Right after the start of image marker, or the segments which
+        // are expected to come first
+        begin = 2;
+        const std::string jfif("JFIF\0", 5);
+        const std::string exif("Exif\0\0", 6);
+        if (header.position(JpegHeader::Marker_APP0, jfif) >= 0)
+            begin = std::max(begin,
+                             header.position(JpegHeader::Marker_APP0, jfif) +
+                             header.size(JpegHeader::Marker_APP0, jfif));
+        if (header.position(JpegHeader::Marker_APP1, exif) >= 0)
+            begin = std::max(begin,
+                             header.position(JpegHeader::Marker_APP1, exif) +
+                             header.size(JpegHeader::Marker_APP1, exif));
+        end = begin;
+    }
+
+    std::string segment;
+    if (!payload.empty()) {
+        const size_t length = payload.size() + 2;
+        segment += (char) 0xff;
+        segment += (char) marker;
+        segment += (char) (length >> 8);
+        segment += (char) (length & 0xff);
+        segment += payload;
+    }
+
+    // What comes before the segment stays as it is
+    data.replace(begin, end - begin, segment);
+    return JpegFile::write(fd, data.data() + begin, data.size() - begin,
+                           begin) &&
+        (ftruncate(fd, data.size()) == 0);
+}
@@ -37,21 +37,35 @@
 **
 ****************************************************************************/
 
-#ifndef EXIF_WRITEBACK_H
-#define EXIF_WRITEBACK_H
+#ifndef SEGMENT_WRITEBACK_H
+#define SEGMENT_WRITEBACK_H
 
-#include <QString>
-#include <QByteArray>
+#include <string>
 
-class ExifWriteback
+/*!
+  Replaces a marker segment of a JPEG file without touching the image:
+  the other segments and the image data are copied as they are.
+ */
+
+class SegmentWriteback
 {
  public:
     /*!
-      Replaces the exif segment of the file with a new one.
+      Replaces the first segment with a given marker and signature, or
+      inserts one after the JFIF and Exif segments if there is none.
+      The file is read and written with pread() and pwrite() through an
+      open descriptor.
+
+      @param payload The payload of the new segment, starting with the
+      signature. If empty, the segment is removed.
+
+      @return false if the file is not a JPEG file, if the payload does
+      not fit into a segment or if the file could not be written.
      */
 
-    static bool writeback(const QString &fileName,
-                          const QByteArray &exifSegment);
+    static bool writeback(int fd, int marker,
+                          const std::string &signature,
+                          const std::string &payload);
 };
 
 #endif
@@ -6,7 +6,8 @@ TEMPLATE = subdirs
 
 CONFIG += ordered
 
-SUBDIRS = src \
+SUBDIRS = core \
+          src \
           tests
 
 contains( doc, no ) {
@@ -17,6 +17,8 @@ URL:        https://github.com/nemomobile/quillmetadata
 Source0:    %{name}-%{version}.tar.bz2
 Source100:  libquillmetadata-qt5.yaml
 Requires:   qt5-plugin-imageformat-jpeg
+Requires:   exempi
+Requires:   libjpeg-turbo
 Requires(post): /sbin/ldconfig
 Requires(postun): /sbin/ldconfig
 BuildRequires:  pkgconfig(Qt5Core)
@@ -96,6 +98,7 @@ rm -rf %{buildroot}
 %files
 %defattr(-,root,root,-)
 %{_libdir}/libquillmetadata-qt5.so.*
+%{_libdir}/libquillmetadata-qt5-core.so.*
 # >> files
 # << files
 
@@ -110,6 +113,8 @@ rm -rf %{buildroot}
 %defattr(-,root,root,-)
 %{_includedir}/qt5/quillmetadata-qt5/*
 %{_libdir}/libquillmetadata-qt5.so
+%{_includedir}/qt5/quillmetadata-qt5-core/*
+%{_libdir}/libquillmetadata-qt5-core.so
 %{_libdir}/pkgconfig/*.pc
 %{_libdir}/*.pc
 # >> files devel
@@ -16,6 +16,8 @@ License:    LGPLv2
 URL:        https://github.com/nemomobile/quillmetadata
 Source0:    %{name}-%{version}.tar.bz2
 Source100:  libquillmetadata.yaml
+Requires:   exempi
+Requires:   libjpeg-turbo
 Requires(post): /sbin/ldconfig
 Requires(postun): /sbin/ldconfig
 BuildRequires:  pkgconfig(QtCore)
@@ -112,5 +114,8 @@ rm %{buildroot}/%{_libdir}/quillmetadata.pc
 %{_libdir}/pkgconfig/quillmetadata.pc
 %{_includedir}/qt4/quillmetadata/*
 %{_libdir}/libquillmetadata.so
+%{_libdir}/pkgconfig/quillmetadata-core.pc
+%{_includedir}/qt4/quillmetadata-core/*
+%{_libdir}/libquillmetadata-core.so
 %{_datadir}/qt4/mkspecs/features/quillmetadata.prf
 # << files devel
@@ -0,0 +1,108 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#include <QLibrary>
+#include <QStringList>
+#include "exempilibrary.h"
+
+ExempiLibrary::ExempiLibrary()
+{
+}
+
+const ExempiLibrary *ExempiLibrary::instance()
+{
+    // Loaded at most once; a failed load is not retried
+    static ExempiLibrary library;
+    static const bool isLoaded = library.load();
+
+    return isLoaded ? &library : 0;
+}
+
+#define RESOLVE(function)                                                \
+    if (!(function = (__typeof__(function)) library.resolve(#function))) \
+        return false;
+
+bool ExempiLibrary::load()
+{
+    // Sonames of exempi 2.5 onwards and of earlier 2.x releases, then
+    // the development symlink as a last resort
+    const QStringList versions = QStringList() << "8" << "3" << QString();
+
+    QLibrary library;
+    foreach (const QString &version, versions) {
+        library.setFileNameAndVersion("exempi", version);
+        if (library.load())
+            break;
+    }
+    if (!library.isLoaded())
+        return false;
+
+    RESOLVE(xmp_init);
+    RESOLVE(xmp_register_namespace);
+    RESOLVE(xmp_new_empty);
+    RESOLVE(xmp_new);
+    RESOLVE(xmp_free);
+    RESOLVE(xmp_serialize);
+    RESOLVE(xmp_has_property);
+    RESOLVE(xmp_get_property);
+    RESOLVE(xmp_get_array_item);
+    RESOLVE(xmp_set_property);
+    RESOLVE(xmp_set_property_float);
+    RESOLVE(xmp_set_property_int32);
+    RESOLVE(xmp_set_localized_text);
+    RESOLVE(xmp_append_array_item);
+    RESOLVE(xmp_delete_property);
+    RESOLVE(xmp_string_new);
+    RESOLVE(xmp_string_free);
+    RESOLVE(xmp_string_cstr);
+    RESOLVE(xmp_iterator_new);
+    RESOLVE(xmp_iterator_next);
+    RESOLVE(xmp_iterator_free);
+    RESOLVE(xmp_files_open_new);
+    RESOLVE(xmp_files_get_new_xmp);
+    RESOLVE(xmp_files_can_put_xmp);
+    RESOLVE(xmp_files_put_xmp);
+    RESOLVE(xmp_files_close);
+    RESOLVE(xmp_files_free);
+
+    // The library stays loaded for the lifetime of the process
+    return xmp_init();
+}
+
+#undef RESOLVE
@@ -0,0 +1,100 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#ifndef EXEMPI_LIBRARY_H
+#define EXEMPI_LIBRARY_H
+
+#include <exempi-2.0/exempi/xmp.h>
+
+/*!
+  The exempi functions used by Xmp, resolved from the library the first
+  time XMP is actually needed. Processes which only touch Exif or IPTC
+  never load or initialize exempi.
+
+  The members have the names and types of the exempi functions, so
+  calls read as exempi->xmp_new_empty().
+ */
+
+class ExempiLibrary
+{
+ public:
+
+    /*!
+      Loads and initializes exempi on the first call.
+
+      @return the loaded library, or 0 if exempi is not available.
+     */
+
+    static const ExempiLibrary *instance();
+
+    __typeof__(&::xmp_init) xmp_init;
+    __typeof__(&::xmp_register_namespace) xmp_register_namespace;
+    __typeof__(&::xmp_new_empty) xmp_new_empty;
+    __typeof__(&::xmp_new) xmp_new;
+    __typeof__(&::xmp_free) xmp_free;
+    __typeof__(&::xmp_serialize) xmp_serialize;
+    __typeof__(&::xmp_has_property) xmp_has_property;
+    __typeof__(&::xmp_get_property) xmp_get_property;
+    __typeof__(&::xmp_get_array_item) xmp_get_array_item;
+    __typeof__(&::xmp_set_property) xmp_set_property;
+    __typeof__(&::xmp_set_property_float) xmp_set_property_float;
+    __typeof__(&::xmp_set_property_int32) xmp_set_property_int32;
+    __typeof__(&::xmp_set_localized_text) xmp_set_localized_text;
+    __typeof__(&::xmp_append_array_item) xmp_append_array_item;
+    __typeof__(&::xmp_delete_property) xmp_delete_property;
+    __typeof__(&::xmp_string_new) xmp_string_new;
+    __typeof__(&::xmp_string_free) xmp_string_free;
+    __typeof__(&::xmp_string_cstr) xmp_string_cstr;
+    __typeof__(&::xmp_iterator_new) xmp_iterator_new;
+    __typeof__(&::xmp_iterator_next) xmp_iterator_next;
+    __typeof__(&::xmp_iterator_free) xmp_iterator_free;
+    __typeof__(&::xmp_files_open_new) xmp_files_open_new;
+    __typeof__(&::xmp_files_get_new_xmp) xmp_files_get_new_xmp;
+    __typeof__(&::xmp_files_can_put_xmp) xmp_files_can_put_xmp;
+    __typeof__(&::xmp_files_put_xmp) xmp_files_put_xmp;
+    __typeof__(&::xmp_files_close) xmp_files_close;
+    __typeof__(&::xmp_files_free) xmp_files_free;
+
+ private:
+    ExempiLibrary();
+
+    bool load();
+};
+
+#endif
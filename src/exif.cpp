@@ -38,10 +38,13 @@
 ****************************************************************************/
 
 #include <stdlib.h>
-#include <libexif/exif-loader.h>
 #include <math.h>
+#include <QStringList>
+#include <QFile>
 #include "exifwriteback.h"
 #include "exif.h"
+#include "exiflayout.h"
+#include "exifpatcher.h"
 
 #define DECIMAL_PRECISION 10000
 
@@ -61,11 +64,45 @@ ExifTypedTag::ExifTypedTag(ExifTag tag, ExifIfd ifd, ExifFormat format,
 }
 
 QHash<QuillMetadata::Tag,ExifTypedTag> Exif::m_exifTags;
-bool Exif::m_initialized = false;
 
-Exif::Exif()
+static inline uint entryKey(int ifd, int tag)
 {
-    m_exifData = exif_data_new();
+    return ((uint)ifd << 16) | (uint)tag;
+}
+
+/*!
+  Resizes the value of an entry, keeping it with the rest of the Exif data.
+ */
+
+static void resizeEntryData(ExifEntry *entry, unsigned int size)
+{
+    if (entry->data && (entry->size == size))
+        return;
+
+    entry->data = (unsigned char*)
+        exif_mem_realloc(ExifArena::mem(), entry->data, size);
+    entry->size = size;
+}
+
+/*!
+  Returns the JPEG thumbnail linked from IFD1 of an Exif block, referring
+  to the data of the block.
+ */
+
+static QByteArray thumbnailOf(const QByteArray &block)
+{
+    size_t offset, length;
+    if (!ExifLayout::thumbnail(block.constData(), block.size(), offset, length))
+        return QByteArray();
+
+    // Not copied, the caller keeps the block alive
+    return QByteArray::fromRawData(block.constData() + offset, length);
+}
+
+Exif::Exif() : m_entryIndexValid(false), m_dumpValid(false)
+{
+    ExifArena::Scope scope(&m_arena);
+    m_exifData = exif_data_new_mem(ExifArena::mem());
     m_exifByteOrder = exif_data_get_byte_order(m_exifData);
     initTags();
 }
@@ -77,68 +114,65 @@ bool Exif::readShortTagAndByteOrder(const QuillMetadata::Tag tagToRead,
     const unsigned char tag1[6] = {0x45, 0x78, 0x69, 0x66, 0x00, 0x00}; // "Exif.."
     const int tag1Length = 6;
     const int bytesBeforeFirstTag = 16;
-    const int tagDataLength = 12;
     const int tag42 = 42;
 
-    ExifTag tagByte = m_exifTags[tagToRead].tag;
+    ExifTag tagByte = m_exifTags.value(tagToRead).tag;
     ExifFormat tagFormat;
-    if ((tagFormat = m_exifTags[tagToRead].format) != EXIF_FORMAT_SHORT)
+    if ((tagFormat = m_exifTags.value(tagToRead).format) != EXIF_FORMAT_SHORT)
         return false;
     ExifLong tagItemCount;
-    if ((tagItemCount = m_exifTags[tagToRead].count) != 1)
+    if ((tagItemCount = m_exifTags.value(tagToRead).count) != 1)
         return false;
 
-    const unsigned char *p = buf;
-    if (p + bytesBeforeFirstTag >= buf + bufSize) // Bytes before tags
+    if (bufSize < (unsigned int)bytesBeforeFirstTag) // Bytes before tags
         return false;
 
-    if (memcmp(p, tag1, tag1Length) != 0) // Exif tag
+    if (memcmp(buf, tag1, tag1Length) != 0) // Exif tag
         return false;
 
-    p += tag1Length; // Data begins here
-    _byteOrder = (*p == 0x49 ? EXIF_BYTE_ORDER_INTEL : EXIF_BYTE_ORDER_MOTOROLA);
+    const unsigned char *tiff = buf + tag1Length; // Data begins here
+    const unsigned int tiffSize = bufSize - tag1Length;
+    _byteOrder = (*tiff == 0x49 ? EXIF_BYTE_ORDER_INTEL : EXIF_BYTE_ORDER_MOTOROLA);
 
-    if (exif_get_short(p+2, _byteOrder) != tag42)  // 42-header-tag
+    if (exif_get_short(tiff+2, _byteOrder) != tag42)  // 42-header-tag
         return false;
 
-    int tagAmount = exif_get_short(p+8, _byteOrder);
-    p += 10; // first tag found here
-
-    const unsigned char *endPoint = p + tagAmount * tagDataLength;
-    if (endPoint+tagDataLength > buf+bufSize)
-        endPoint = buf+bufSize - tagDataLength;
+    // IFD0 does not necessarily follow the header
+    int pos = ExifLayout::findEntry(tiff, tiffSize, _byteOrder,
+                                    exif_get_long(tiff+4, _byteOrder), tagByte);
+    if (pos < 0)
+        return false; // No tag found
 
-    for (const unsigned char *tag = p; tag < endPoint; tag += tagDataLength) {
-        if ( (exif_get_short(tag, _byteOrder) == tagByte) ) { // Correct tag
-            if ( (exif_get_long(tag+4, _byteOrder) == tagItemCount) && // Correct amount of values
-                 (exif_get_short(tag+2, _byteOrder) == tagFormat) ) { // Correct format
-                    _tagValue = exif_get_short(tag+8, _byteOrder);
-            }
-            return true; // Correct tag found: return
-        }
+    const unsigned char *tag = tiff + pos;
+    if ( (exif_get_long(tag+4, _byteOrder) == tagItemCount) && // Correct amount of values
+         (exif_get_short(tag+2, _byteOrder) == tagFormat) ) { // Correct format
+        _tagValue = exif_get_short(tag+8, _byteOrder);
     }
-    return false; // No tag found
+    return true; // Correct tag found: return
 }
 
-Exif::Exif(const QString &fileName, QuillMetadata::Tag tagToRead)
+Exif::Exif(const QByteArray &exifBlock, QuillMetadata::Tag tagToRead,
+           bool isMakerNoteOpaque) :
+    m_entryIndexValid(false), m_dumpValid(false)
 {
     initTags();
+    m_block = exifBlock;
 
-    ExifLoader *loader = exif_loader_new();
-    exif_loader_write_file(loader, fileName.toLocal8Bit().constData());
-
-    const unsigned char *buf = 0;
-    unsigned int bufSize = 0;
-    exif_loader_get_buf(loader, &buf, &bufSize);
+    const unsigned char *buf = (const unsigned char*)exifBlock.constData();
+    unsigned int bufSize = exifBlock.size();
 
-    m_exifData = exif_data_new();
+    ExifArena::Scope scope(&m_arena);
+    m_exifData = exif_data_new_mem(ExifArena::mem());
     exif_data_unset_option(m_exifData, EXIF_DATA_OPTION_FOLLOW_SPECIFICATION);
 
     if (tagToRead == QuillMetadata::Tag_Undefined) // Load all tags
     {
-        exif_data_load_data(m_exifData, buf, bufSize);
-        exif_loader_unref(loader);
+        if (isMakerNoteOpaque)
+            loadWithOpaqueMakerNote(exifBlock);
+        else
+            exif_data_load_data(m_exifData, buf, bufSize);
 
+        m_originalBlock = exifBlock;
         m_exifByteOrder = exif_data_get_byte_order(m_exifData);
         return;
     }
@@ -149,18 +183,84 @@ Exif::Exif(const QString &fileName, QuillMetadata::Tag tagToRead)
     bool success =
         readShortTagAndByteOrder(tagToRead, buf, bufSize, tagValue, byteOrder);
 
-    exif_loader_unref(loader);
-
     if (success) {
         m_exifByteOrder = byteOrder;
         this->setEntry(QuillMetadata::Tag_Orientation, tagValue);
     }
 }
 
+void Exif::loadWithOpaqueMakerNote(const QByteArray &exifBlock)
+{
+    const int headerLength = 6; // "Exif\0\0"
+    const int unknownTag = 0xffff;
+
+    const unsigned char *tiff =
+        (const unsigned char*)exifBlock.constData() + headerLength;
+    const unsigned int size = qMax(exifBlock.size() - headerLength, 0);
+
+    int entryPos = -1;
+    ExifByteOrder byteOrder = EXIF_BYTE_ORDER_INTEL;
+    if (size >= 8) {
+        byteOrder = (tiff[0] == 'I') ? EXIF_BYTE_ORDER_INTEL : EXIF_BYTE_ORDER_MOTOROLA;
+        int pointerPos = ExifLayout::findEntry(tiff, size, byteOrder,
+                                               exif_get_long(tiff + 4, byteOrder),
+                                               EXIF_TAG_EXIF_IFD_POINTER);
+        if (pointerPos >= 0)
+            entryPos = ExifLayout::findEntry(tiff, size, byteOrder,
+                                             exif_get_long(tiff + pointerPos + 8, byteOrder),
+                                             EXIF_TAG_MAKER_NOTE);
+    }
+
+    if (entryPos < 0) {
+        exif_data_load_data(m_exifData,
+                            (const unsigned char*)exifBlock.constData(),
+                            exifBlock.size());
+        return;
+    }
+
+    // Hide the MakerNote from libexif by giving it a tag libexif does not
+    // know, so that it is not interpreted. Other unknown tags are kept,
+    // and only the renamed entry is removed again after loading.
+    QByteArray block = exifBlock;
+    exif_set_short((unsigned char*)block.data() + headerLength + entryPos,
+                   byteOrder, unknownTag);
+    exif_data_unset_option(m_exifData, EXIF_DATA_OPTION_IGNORE_UNKNOWN_TAGS);
+    exif_data_load_data(m_exifData, (const unsigned char*)block.constData(),
+                        block.size());
+
+    ExifEntry *renamed = exif_content_get_entry(m_exifData->ifd[EXIF_IFD_EXIF],
+                                                (ExifTag)unknownTag);
+    if (renamed)
+        exif_content_remove_entry(m_exifData->ifd[EXIF_IFD_EXIF], renamed);
+
+    // Then add the MakerNote back as an uninterpreted blob
+    ExifFormat format = (ExifFormat)exif_get_short(tiff + entryPos + 2, byteOrder);
+    unsigned int components = exif_get_long(tiff + entryPos + 4, byteOrder);
+    unsigned int formatSize = exif_format_get_size(format);
+    if ((formatSize == 0) || (components > size / formatSize))
+        return;
+
+    unsigned int dataSize = formatSize * components;
+    unsigned int dataOffset = (dataSize > 4) ?
+        exif_get_long(tiff + entryPos + 8, byteOrder) : entryPos + 8;
+    if ((dataOffset > size) || (dataSize > size - dataOffset))
+        return;
+
+    ExifEntry *entry = exif_entry_new_mem(ExifArena::mem());
+    entry->tag = EXIF_TAG_MAKER_NOTE;
+    entry->format = format;
+    entry->components = components;
+    resizeEntryData(entry, dataSize);
+    memcpy(entry->data, tiff + dataOffset, dataSize);
+    exif_content_add_entry(m_exifData->ifd[EXIF_IFD_EXIF], entry);
+    exif_entry_unref(entry);
+}
+
 Exif::~Exif()
 {
     //the entry, content will be freed recursively, we do not unref content and entry explicitly.
     //otherwise, there is a crashing
+    ExifArena::Scope scope(&m_arena);
     exif_data_unref(m_exifData);
 }
 
@@ -176,21 +276,96 @@ bool Exif::supportsEntry(QuillMetadata::Tag tag) const
 
 bool Exif::hasEntry(QuillMetadata::Tag tag) const
 {
-    return (supportsEntry(tag) &&
-            exif_data_get_entry(m_exifData, m_exifTags[tag].tag));
+    return (exifEntry(tag) != 0);
 }
 
-QVariant Exif::entry(QuillMetadata::Tag tag) const
+ExifEntry *Exif::findEntry(ExifIfd ifd, ExifTag tag) const
+{
+    if (!m_entryIndexValid) {
+        m_entryIndex.clear();
+        for (int i = 0; i < EXIF_IFD_COUNT; i++) {
+            ExifContent *content = m_exifData->ifd[i];
+            for (unsigned int j = 0; j < content->count; j++)
+                m_entryIndex.insert(entryKey(i, content->entries[j]->tag),
+                                    content->entries[j]);
+        }
+        m_entryIndexValid = true;
+    }
+
+    return m_entryIndex.value(entryKey(ifd, tag), 0);
+}
+
+ExifIfd Exif::alternativeIfd(ExifIfd ifd)
+{
+    // Some writers put Exif IFD tags into IFD 0 and vice versa
+    switch (ifd) {
+    case EXIF_IFD_0:
+        return EXIF_IFD_EXIF;
+    case EXIF_IFD_EXIF:
+        return EXIF_IFD_0;
+    default:
+        return EXIF_IFD_COUNT;
+    }
+}
+
+ExifEntry *Exif::exifEntry(QuillMetadata::Tag tag) const
 {
     if (!supportsEntry(tag))
-        return QVariant();
+        return 0;
 
     if (!m_exifData)
-        return QVariant();
+        return 0;
+
+    const ExifTypedTag &typedTag = m_exifTags.value(tag);
+
+    ExifEntry *entry = findEntry(typedTag.ifd, typedTag.tag);
+    if (!entry && (alternativeIfd(typedTag.ifd) != EXIF_IFD_COUNT))
+        entry = findEntry(alternativeIfd(typedTag.ifd), typedTag.tag);
+
+    return entry;
+}
+
+/*!
+  Converts a degrees, minutes, seconds rational triplet into degrees.
+ */
+
+static double coordinateValue(const ExifEntry *entry, ExifByteOrder byteOrder)
+{
+    unsigned char formatSize = exif_format_get_size(EXIF_FORMAT_RATIONAL);
+    double val = 0.0;
+    int power = 1;
+
+    for (unsigned int i = 0; i < 3 && (i + 1) * formatSize <= entry->size; i ++) {
+        ExifRational cRat = exif_get_rational(entry->data + i * formatSize, byteOrder);
+        if (cRat.denominator != 0) {
+            val += ((float)cRat.numerator / (float)cRat.denominator) / power;
+            power *= 60;
+        }
+    }
+    return val;
+}
+
+QVariant Exif::entry(QuillMetadata::Tag tag) const
+{
+    return entryValue(tag, exifEntry(tag));
+}
 
-    ExifTag exifTag = m_exifTags[tag].tag;
+void Exif::entries(const QList<QuillMetadata::Tag> &tags,
+                   QMap<QuillMetadata::Tag, QVariant> &result) const
+{
+    if (!m_exifData)
+        return;
+
+    // The IFDs are walked only once, when the entry index is built
+    foreach (QuillMetadata::Tag tag, tags) {
+        QVariant value = entryValue(tag, exifEntry(tag));
+        if (!value.isNull())
+            result.insert(tag, value);
+    }
+}
 
-    ExifEntry *entry = exif_data_get_entry(m_exifData, exifTag);
+QVariant Exif::entryValue(QuillMetadata::Tag tag, ExifEntry *entry) const
+{
     if (!entry)
         return QVariant();
 
@@ -198,6 +373,13 @@ QVariant Exif::entry(QuillMetadata::Tag tag) const
 
     switch(entry->format) {
     case EXIF_FORMAT_BYTE:
+        // A single byte is a number, such as GPSAltitudeRef
+        if (entry->data && (entry->components == 1))
+            result = QVariant(int(entry->data[0]));
+        else
+            result = QVariant(QByteArray((const char*)entry->data,entry->size));
+        break;
+
     case EXIF_FORMAT_ASCII:
         result = QVariant(QByteArray((const char*)entry->data,entry->size));
         break;
@@ -211,21 +393,10 @@ QVariant Exif::entry(QuillMetadata::Tag tag) const
         break;
 
     case EXIF_FORMAT_RATIONAL: {
-        unsigned char formatSize = exif_format_get_size(EXIF_FORMAT_RATIONAL);
-        double val = 0.0;
-        int power = 1;
-
         switch(tag) {
         case QuillMetadata::Tag_GPSLatitude:
         case QuillMetadata::Tag_GPSLongitude:
-            for (int i = 0; i < 3; i ++) {
-                ExifRational cRat = exif_get_rational(entry->data + i * formatSize, m_exifByteOrder);
-                if (cRat.denominator != 0) {
-                    val += ((float)cRat.numerator / (float)cRat.denominator) / power;
-                    power *= 60;
-                }
-            }
-            result = QVariant(val);
+            result = QVariant(coordinateValue(entry, m_exifByteOrder));
             break;
 
         case QuillMetadata::Tag_GPSAltitude:
@@ -271,14 +442,140 @@ QVariant Exif::entry(QuillMetadata::Tag tag) const
     return result;
 }
 
+bool Exif::entry(QuillMetadata::Tag tag, int &value) const
+{
+    ExifEntry *entry = exifEntry(tag);
+    if (!entry || !entry->data ||
+        entry->size < exif_format_get_size(entry->format))
+        return false;
+
+    switch(entry->format) {
+    case EXIF_FORMAT_BYTE:
+        value = entry->data[0];
+        return true;
+
+    case EXIF_FORMAT_SHORT:
+        value = exif_get_short(entry->data, m_exifByteOrder);
+        return true;
+
+    case EXIF_FORMAT_LONG:
+        value = exif_get_long(entry->data, m_exifByteOrder);
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+bool Exif::entry(QuillMetadata::Tag tag, double &value) const
+{
+    ExifEntry *entry = exifEntry(tag);
+    if (!entry || !entry->data ||
+        entry->size < exif_format_get_size(entry->format))
+        return false;
+
+    switch(entry->format) {
+    case EXIF_FORMAT_SHORT:
+        value = exif_get_short(entry->data, m_exifByteOrder);
+        return true;
+
+    case EXIF_FORMAT_LONG:
+        value = exif_get_long(entry->data, m_exifByteOrder);
+        return true;
+
+    case EXIF_FORMAT_RATIONAL: {
+        if ((tag == QuillMetadata::Tag_GPSLatitude) ||
+            (tag == QuillMetadata::Tag_GPSLongitude)) {
+            value = coordinateValue(entry, m_exifByteOrder);
+            return true;
+        }
+        ExifRational rational = exif_get_rational(entry->data, m_exifByteOrder);
+        if (rational.denominator == 0)
+            return false;
+        value = (double)rational.numerator / (double)rational.denominator;
+        return true;
+    }
+
+    case EXIF_FORMAT_SRATIONAL: {
+        ExifSRational srational = exif_get_srational(entry->data, m_exifByteOrder);
+        if (srational.denominator == 0)
+            return false;
+        value = (double)srational.numerator / (double)srational.denominator;
+        return true;
+    }
+
+    default:
+        return false;
+    }
+}
+
+bool Exif::entry(QuillMetadata::Tag tag, QString &value) const
+{
+    ExifEntry *entry = exifEntry(tag);
+    if (!entry || !entry->data)
+        return false;
+
+    switch(entry->format) {
+    case EXIF_FORMAT_ASCII:
+        value = QString::fromLatin1((const char*)entry->data,
+                                    qstrnlen((const char*)entry->data,
+                                             entry->size));
+        return true;
+
+    case EXIF_FORMAT_BYTE: {
+        // Byte arrays such as GPSVersionID are shown as "2.2.0.0"
+        QStringList bytes;
+        for (unsigned int i = 0; i < entry->size; i++)
+            bytes << QString::number(entry->data[i]);
+        value = bytes.join(".");
+        return true;
+    }
+
+    default:
+        return false;
+    }
+}
+
+bool Exif::entry(QuillMetadata::Tag tag, QDateTime &value) const
+{
+    // EXIF timestamps are always "YYYY:MM:DD HH:MM:SS"
+    static const int offsets[6] = {0, 5, 8, 11, 14, 17};
+    static const int lengths[6] = {4, 2, 2, 2, 2, 2};
+    const unsigned int timestampLength = 19;
+
+    ExifEntry *entry = exifEntry(tag);
+    if (!entry || !entry->data || (entry->format != EXIF_FORMAT_ASCII) ||
+        (entry->size < timestampLength))
+        return false;
+
+    int fields[6];
+    for (int i = 0; i < 6; i++) {
+        fields[i] = 0;
+        for (int j = 0; j < lengths[i]; j++) {
+            unsigned char c = entry->data[offsets[i] + j];
+            if ((c < '0') || (c > '9'))
+                return false;
+            fields[i] = fields[i] * 10 + (c - '0');
+        }
+    }
+
+    QDate date(fields[0], fields[1], fields[2]);
+    QTime time(fields[3], fields[4], fields[5]);
+    if (!date.isValid() || !time.isValid())
+        return false;
+
+    value = QDateTime(date, time);
+    return true;
+}
+
 void Exif::setExifEntry(ExifData *data, ExifTypedTag tag, const QVariant &value)
 {
     ExifContent *content = data->ifd[tag.ifd];
 
     bool entryIsNew = false;
-    ExifEntry *entry = exif_content_get_entry(content, tag.tag);
+    ExifEntry *entry = findEntry(tag.ifd, tag.tag);
     if (!entry) {
-        entry = exif_entry_new();
+        entry = exif_entry_new_mem(ExifArena::mem());
         exif_entry_initialize(entry, tag.tag);
         entryIsNew = true;
     }
@@ -287,29 +584,24 @@ void Exif::setExifEntry(ExifData *data, ExifTypedTag tag, const QVariant &value)
     entry->format = tag.format;
 
     switch(entry->format) {
-    case EXIF_FORMAT_ASCII:
-        if(entryIsNew)
-            entry->data = (unsigned char*)
-                malloc(value.toByteArray().size() * sizeof(unsigned char));
-        memcpy((char*)entry->data, value.toByteArray().constData(),value.toByteArray().size());
-        entry->size = value.toByteArray().size();
+    case EXIF_FORMAT_ASCII: {
+        const QByteArray bytes = value.toByteArray();
+        resizeEntryData(entry, bytes.size());
+        memcpy((char*)entry->data, bytes.constData(), bytes.size());
         entry->components = entry->size;
         break;
+    }
 
     case EXIF_FORMAT_BYTE:
         entry->components = 1;
-        entry->size = exif_format_get_size(EXIF_FORMAT_BYTE) * entry->components;
-        if(entryIsNew)
-            entry->data = (unsigned char*) malloc(entry->size);
-        memcpy((char*)entry->data, value.toByteArray().constData(), value.toByteArray().size());
+        resizeEntryData(entry, exif_format_get_size(EXIF_FORMAT_BYTE) *
+                        entry->components);
+        entry->data[0] = value.toInt();
         break;
 
     case EXIF_FORMAT_SHORT:
-        if(entryIsNew)
-            entry->data = (unsigned char*)
-                malloc(exif_format_get_size(EXIF_FORMAT_SHORT));
+        resizeEntryData(entry, exif_format_get_size(EXIF_FORMAT_SHORT));
         exif_set_short(entry->data, m_exifByteOrder, value.toInt());
-        entry->size = exif_format_get_size(EXIF_FORMAT_SHORT);
         entry->components = 1;
         break;
 
@@ -322,9 +614,8 @@ void Exif::setExifEntry(ExifData *data, ExifTypedTag tag, const QVariant &value)
             ExifRational rat;
 
             entry->components = 3;
-            entry->size = exif_format_get_size(EXIF_FORMAT_RATIONAL) * entry->components;
-            if(entryIsNew)
-                entry->data = (unsigned char *) malloc(entry->size);
+            resizeEntryData(entry, exif_format_get_size(EXIF_FORMAT_RATIONAL) *
+                            entry->components);
             double val = value.toDouble();
             updateReferenceTag(entry->tag, val >= 0);
             val = fabs(val);
@@ -360,9 +651,8 @@ void Exif::setExifEntry(ExifData *data, ExifTypedTag tag, const QVariant &value)
             }
 
             entry->components = 1;
-            entry->size = exif_format_get_size(EXIF_FORMAT_RATIONAL) * entry->components;
-            if(entryIsNew)
-                entry->data = (unsigned char *) malloc(entry->size);
+            resizeEntryData(entry, exif_format_get_size(EXIF_FORMAT_RATIONAL) *
+                            entry->components);
 
             rat.numerator = round(val * DECIMAL_PRECISION);
             rat.denominator = DECIMAL_PRECISION;
@@ -380,8 +670,11 @@ void Exif::setExifEntry(ExifData *data, ExifTypedTag tag, const QVariant &value)
     }
 
     exif_content_add_entry(content, entry);
-    if (entryIsNew)
+    m_modifiedEntries.insert(entryKey(tag.ifd, tag.tag));
+    if (entryIsNew) {
+        m_entryIndex.insert(entryKey(tag.ifd, tag.tag), entry);
         exif_entry_unref(entry);
+    }
 }
 
 void Exif::updateReferenceTag(ExifTag tag, bool positive)
@@ -408,12 +701,16 @@ void Exif::setEntry(QuillMetadata::Tag tag, const QVariant &value)
     if (!supportsEntry(tag))
         return;
 
+    ExifArena::Scope scope(&m_arena);
+    m_dumpValid = false;
+
     if (!m_exifData) {
-        m_exifData = exif_data_new();
+        m_exifData = exif_data_new_mem(ExifArena::mem());
         m_exifByteOrder = exif_data_get_byte_order(m_exifData);
+        m_entryIndexValid = false;
     }
 
-    setExifEntry(m_exifData, m_exifTags[tag], value);
+    setExifEntry(m_exifData, m_exifTags.value(tag), value);
 }
 
 void Exif::removeEntry(QuillMetadata::Tag tag)
@@ -421,13 +718,23 @@ void Exif::removeEntry(QuillMetadata::Tag tag)
     if (!supportsEntry(tag) || !m_exifData)
         return;
 
-    ExifTypedTag typedTag = m_exifTags[tag];
+    ExifTypedTag typedTag = m_exifTags.value(tag);
 
-    ExifContent *content = m_exifData->ifd[typedTag.ifd];
+    ExifArena::Scope scope(&m_arena);
+    m_dumpValid = false;
+    removeExifEntry(typedTag.ifd, typedTag.tag);
+    if (alternativeIfd(typedTag.ifd) != EXIF_IFD_COUNT)
+        removeExifEntry(alternativeIfd(typedTag.ifd), typedTag.tag);
+}
 
-    ExifEntry *entry = exif_content_get_entry(content, typedTag.tag);
-    if (entry)
-        exif_content_remove_entry(content, entry);
+void Exif::removeExifEntry(ExifIfd ifd, ExifTag tag)
+{
+    ExifEntry *entry = findEntry(ifd, tag);
+    if (entry) {
+        m_entryIndex.remove(entryKey(ifd, tag));
+        m_modifiedEntries.insert(entryKey(ifd, tag));
+        exif_content_remove_entry(m_exifData->ifd[ifd], entry);
+    }
 }
 
 void Exif::removeEntries(QuillMetadata::TagGroup tagGroup)
@@ -435,22 +742,67 @@ void Exif::removeEntries(QuillMetadata::TagGroup tagGroup)
     if (!m_exifData)
         return;
 
+    ExifArena::Scope scope(&m_arena);
+    m_dumpValid = false;
+
     /* Remove all tags in the tag group */
     if (tagGroup == QuillMetadata::TagGroup_GPS) {
-        ExifContent *content = m_exifData->ifd[EXIF_IFD_GPS];
         for (int t=(int)EXIF_TAG_GPS_VERSION_ID; // first GPS tag
              t<=(int)EXIF_TAG_GPS_DIFFERENTIAL; t++) // last GPS tag
-            {
-                ExifEntry *entry = exif_content_get_entry(content, (ExifTag)t);
-                if (entry)
-                    exif_content_remove_entry(content, entry);
-            }
+            removeExifEntry(EXIF_IFD_GPS, (ExifTag)t);
+    }
+}
+
+bool Exif::load(const QByteArray &data)
+{
+    ExifArena::Scope scope(&m_arena);
+
+    ExifData *exifData = exif_data_new_mem(ExifArena::mem());
+    exif_data_unset_option(exifData, EXIF_DATA_OPTION_FOLLOW_SPECIFICATION);
+    exif_data_load_data(exifData, (const unsigned char*)data.constData(),
+                        data.size());
+
+    // libexif does not report errors, an unparseable block has no entries
+    bool hasEntries = false;
+    for (int i = 0; i < EXIF_IFD_COUNT; i++)
+        if (exifData->ifd[i]->count > 0)
+            hasEntries = true;
+
+    if (!hasEntries) {
+        exif_data_unref(exifData);
+        return false;
     }
+
+    if (m_exifData)
+        exif_data_unref(m_exifData);
+    m_exifData = exifData;
+    m_exifByteOrder = exif_data_get_byte_order(m_exifData);
+    m_entryIndexValid = false;
+    m_dumpValid = false;
+    m_block = data;
+    m_originalBlock = data;
+    m_modifiedEntries.clear();
+
+    return true;
+}
+
+bool Exif::write(const QString &fileName, bool generateThumbnail) const
+{
+    const QByteArray block = dump();
+    // An existing thumbnail is kept as it is
+    return ExifWriteback::writeback(QFile::encodeName(fileName).constData(),
+                                    std::string(block.constData(), block.size()),
+                                    generateThumbnail &&
+                                    thumbnailOf(block).isEmpty());
 }
 
-bool Exif::write(const QString &fileName) const
+bool Exif::write(int fd, bool generateThumbnail) const
 {
-    return ExifWriteback::writeback(fileName, dump());
+    const QByteArray block = dump();
+    return ExifWriteback::writeback(fd,
+                                    std::string(block.constData(), block.size()),
+                                    generateThumbnail &&
+                                    thumbnailOf(block).isEmpty());
 }
 
 QByteArray Exif::dump() const
@@ -458,25 +810,66 @@ QByteArray Exif::dump() const
     if (!m_exifData)
         return QByteArray();
 
+    // The copy is shared with all callers until the data is modified
+    if (m_dumpValid)
+        return m_dump;
+
+    // Patching the original block keeps whatever libexif would not save
+    if (!m_originalBlock.isEmpty()) {
+        std::map<unsigned int, const ExifEntry*> entries;
+        foreach (uint key, m_modifiedEntries)
+            entries[key] = findEntry((ExifIfd)(key >> 16),
+                                     (ExifTag)(key & 0xffff));
+        if (entries.empty())
+            m_dump = m_originalBlock;
+        else {
+            const std::string patched =
+                ExifPatcher(std::string(m_originalBlock.constData(),
+                                        m_originalBlock.size())).patch(entries);
+            m_dump = QByteArray(patched.data(), patched.size());
+        }
+        if (!m_dump.isEmpty()) {
+            m_dumpValid = true;
+            return m_dump;
+        }
+    }
+
+    ExifArena::Scope scope(&m_arena);
+
     unsigned char *d;
     unsigned int ds;
 
     // Since the data is not fixed on load, fix it on save instead.
     exif_data_fix(m_exifData);
+    m_entryIndexValid = false;
     exif_data_save_data(m_exifData, &d, &ds);
-    QByteArray result = QByteArray((char*)d, ds);
-    free(d);
+    m_dump = QByteArray((char*)d, ds);
+    m_dumpValid = true;
+    exif_mem_free(ExifArena::mem(), d);
 
-    return result;
+    return m_dump;
 }
 
-void Exif::initTags()
+QByteArray Exif::thumbnail() const
 {
-    if (m_initialized)
-        return;
+    return thumbnailOf(m_block);
+}
 
-    m_initialized = true;
+bool Exif::hasThumbnail() const
+{
+    return !thumbnailOf(dump()).isEmpty();
+}
+
+void Exif::initTags()
+{
+    // Filled by the first caller; later calls only check the guard of
+    // the local static, without locking
+    static const bool isFilled = fillTags();
+    Q_UNUSED(isFilled);
+}
 
+bool Exif::fillTags()
+{
     m_exifTags.insert(QuillMetadata::Tag_Make,
                       ExifTypedTag(EXIF_TAG_MAKE,
                                    EXIF_IFD_0,
@@ -495,15 +888,15 @@ void Exif::initTags()
                                    EXIF_FORMAT_SHORT));
     m_exifTags.insert(QuillMetadata::Tag_FocalLength,
                       ExifTypedTag(EXIF_TAG_FOCAL_LENGTH,
-                                   EXIF_IFD_0,
+                                   EXIF_IFD_EXIF,
                                    EXIF_FORMAT_RATIONAL));
     m_exifTags.insert(QuillMetadata::Tag_ExposureTime,
                       ExifTypedTag(EXIF_TAG_EXPOSURE_TIME,
-                                   EXIF_IFD_0,
+                                   EXIF_IFD_EXIF,
                                    EXIF_FORMAT_RATIONAL));
     m_exifTags.insert(QuillMetadata::Tag_TimestampOriginal,
                       ExifTypedTag(EXIF_TAG_DATE_TIME_ORIGINAL,
-                                   EXIF_IFD_0,
+                                   EXIF_IFD_EXIF,
                                    EXIF_FORMAT_ASCII));
     m_exifTags.insert(QuillMetadata::Tag_Orientation,
                       ExifTypedTag(EXIF_TAG_ORIENTATION,
@@ -541,4 +934,6 @@ void Exif::initTags()
                       ExifTypedTag((ExifTag)EXIF_TAG_GPS_IMG_DIRECTION_REF,
                                    EXIF_IFD_GPS,
                                    EXIF_FORMAT_ASCII));
+
+    return true;
 }
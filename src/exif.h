@@ -43,8 +43,11 @@
 #include <libexif/exif-data.h>
 #include <QString>
 #include <QHash>
+#include <QMap>
+#include <QSet>
 
 #include "metadatarepresentation.h"
+#include "exifarena.h"
 
 class ExifTypedTag {
 public:
@@ -62,8 +65,9 @@ class Exif : public MetadataRepresentation
 {
  public:
     Exif();
-    Exif(const QString &fileName,
-         QuillMetadata::Tag tagToRead = QuillMetadata::Tag_Undefined);
+    Exif(const QByteArray &exifBlock,
+         QuillMetadata::Tag tagToRead = QuillMetadata::Tag_Undefined,
+         bool isMakerNoteOpaque = false);
     ~Exif();
 
     bool isValid() const;
@@ -71,15 +75,39 @@ class Exif : public MetadataRepresentation
     bool supportsEntry(QuillMetadata::Tag tag) const;
     bool hasEntry(QuillMetadata::Tag tag) const;
     QVariant entry(QuillMetadata::Tag tag) const;
+    bool entry(QuillMetadata::Tag tag, int &value) const;
+    bool entry(QuillMetadata::Tag tag, double &value) const;
+    bool entry(QuillMetadata::Tag tag, QString &value) const;
+    bool entry(QuillMetadata::Tag tag, QDateTime &value) const;
+    void entries(const QList<QuillMetadata::Tag> &tags,
+                 QMap<QuillMetadata::Tag, QVariant> &result) const;
     void setEntry(QuillMetadata::Tag tag, const QVariant &entry);
     void removeEntry(QuillMetadata::Tag tag);
     void removeEntries(QuillMetadata::TagGroup tagGroup);
 
-    bool write(const QString &fileName) const;
+    bool load(const QByteArray &data);
+    bool write(const QString &fileName, bool generateThumbnail = false) const;
+    bool write(int fd, bool generateThumbnail = false) const;
     QByteArray dump() const;
 
+    QByteArray thumbnail() const;
+    bool hasThumbnail() const;
+
  private:
     void initTags();
+    static bool fillTags();
+
+    void loadWithOpaqueMakerNote(const QByteArray &exifBlock);
+
+    ExifEntry *exifEntry(QuillMetadata::Tag tag) const;
+
+    ExifEntry *findEntry(ExifIfd ifd, ExifTag tag) const;
+
+    static ExifIfd alternativeIfd(ExifIfd ifd);
+
+    void removeExifEntry(ExifIfd ifd, ExifTag tag);
+
+    QVariant entryValue(QuillMetadata::Tag tag, ExifEntry *entry) const;
 
     void setExifEntry(ExifData *data, ExifTypedTag tag, const QVariant &value);
 
@@ -92,10 +120,27 @@ class Exif : public MetadataRepresentation
  private:
     static QHash<QuillMetadata::Tag,ExifTypedTag> m_exifTags;
 
+    // Backs all libexif allocations of m_exifData
+    mutable ExifArena m_arena;
+
     ExifData *m_exifData;
     ExifByteOrder m_exifByteOrder;
 
-    static bool m_initialized;
+    // Entries by IFD and tag, built on first lookup
+    mutable QHash<uint, ExifEntry*> m_entryIndex;
+    mutable bool m_entryIndexValid;
+
+    // Serialized data, kept until the next modification
+    mutable QByteArray m_dump;
+    mutable bool m_dumpValid;
+
+    // The block as read, also when only a single tag was loaded
+    QByteArray m_block;
+
+    // The block the data was loaded from, and what has changed since
+    QByteArray m_originalBlock;
+    QSet<uint> m_modifiedEntries;
+
 };
 
 #endif
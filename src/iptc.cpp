@@ -0,0 +1,252 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#include <string.h>
+#include <QStringList>
+
+#include "iptc.h"
+
+// Photoshop image resource holding the IPTC-IIM datasets
+static const int IptcNaaResource = 0x0404;
+
+// IIM records, and the envelope dataset naming the character set
+static const int EnvelopeRecord = 1;
+static const int ApplicationRecord = 2;
+static const int CodedCharacterSet = 90;
+
+QHash<QuillMetadata::Tag,int> Iptc::m_iptcTags;
+
+static inline int readShort(const uchar *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static inline uint readLong(const uchar *p)
+{
+    return ((uint)p[0] << 24) | ((uint)p[1] << 16) | ((uint)p[2] << 8) | p[3];
+}
+
+Iptc::Iptc() : m_isUtf8(false)
+{
+    initTags();
+}
+
+Iptc::Iptc(const QByteArray &photoshopBlock) :
+    m_data(photoshopBlock), m_isUtf8(false)
+{
+    initTags();
+
+    const char signature[] = "Photoshop 3.0"; // including the terminating 0
+    const int signatureLength = sizeof(signature);
+    const int resourceHeaderLength = 12;
+
+    if (m_data.size() < signatureLength ||
+        memcmp(m_data.constData(), signature, signatureLength) != 0)
+        return;
+
+    // A sequence of "8BIM" resources: id, padded Pascal name, size, data
+    const uchar *data = (const uchar*)m_data.constData();
+    const int size = m_data.size();
+    int pos = signatureLength;
+
+    while ((pos + resourceHeaderLength <= size) &&
+           (memcmp(data + pos, "8BIM", 4) == 0)) {
+        const int id = readShort(data + pos + 4);
+        const int nameSize = (1 + data[pos + 6] + 1) & ~1;
+        const int sizePos = pos + 6 + nameSize;
+        if (sizePos + 4 > size)
+            break;
+
+        const uint resourceSize = readLong(data + sizePos);
+        const int dataPos = sizePos + 4;
+        if (resourceSize > (uint)(size - dataPos))
+            break;
+
+        if (id == IptcNaaResource)
+            readDatasets(dataPos, dataPos + resourceSize);
+
+        pos = dataPos + ((resourceSize + 1) & ~1);
+    }
+}
+
+void Iptc::readDatasets(int pos, int end)
+{
+    const uchar *data = (const uchar*)m_data.constData();
+
+    // Tag marker, record, dataset and a two-byte or extended length
+    while ((pos + 5 <= end) && (data[pos] == 0x1c)) {
+        const int record = data[pos + 1];
+        const int dataset = data[pos + 2];
+        uint length = readShort(data + pos + 3);
+        pos += 5;
+
+        if (length & 0x8000) {
+            // The length is in the next (length & 0x7fff) bytes
+            const int lengthSize = length & 0x7fff;
+            if ((lengthSize > 4) || (pos + lengthSize > end))
+                return;
+            length = 0;
+            for (int i = 0; i < lengthSize; i++)
+                length = (length << 8) | data[pos++];
+        }
+
+        if (length > (uint)(end - pos))
+            return;
+
+        if ((record == EnvelopeRecord) && (dataset == CodedCharacterSet))
+            m_isUtf8 = (length >= 3) && (memcmp(data + pos, "\x1b%G", 3) == 0);
+        else if (record == ApplicationRecord) {
+            Range range;
+            range.offset = pos;
+            range.size = length;
+            m_datasets[dataset].append(range);
+        }
+
+        pos += length;
+    }
+}
+
+QString Iptc::value(const Range &range) const
+{
+    // Without a coded character set, IIM text is ISO 8859-1 in practice
+    const char *data = m_data.constData() + range.offset;
+    if (m_isUtf8)
+        return QString::fromUtf8(data, range.size);
+    else
+        return QString::fromLatin1(data, range.size);
+}
+
+bool Iptc::isValid() const
+{
+    return !m_datasets.isEmpty();
+}
+
+bool Iptc::supportsEntry(QuillMetadata::Tag tag) const
+{
+    return m_iptcTags.contains(tag);
+}
+
+bool Iptc::hasEntry(QuillMetadata::Tag tag) const
+{
+    return supportsEntry(tag) && m_datasets.contains(m_iptcTags.value(tag));
+}
+
+QVariant Iptc::entry(QuillMetadata::Tag tag) const
+{
+    if (tag == QuillMetadata::Tag_Subject) {
+        QStringList values;
+        if (entry(tag, values))
+            return QVariant(values);
+    }
+    else {
+        QString value;
+        if (entry(tag, value))
+            return QVariant(value);
+    }
+
+    return QVariant();
+}
+
+bool Iptc::entry(QuillMetadata::Tag tag, QString &value) const
+{
+    if (!hasEntry(tag))
+        return false;
+
+    // Repeatable datasets such as By-line give their first value
+    value = this->value(m_datasets.value(m_iptcTags.value(tag)).first());
+    return true;
+}
+
+bool Iptc::entry(QuillMetadata::Tag tag, QStringList &value) const
+{
+    if (!hasEntry(tag))
+        return false;
+
+    value.clear();
+    foreach (const Range &range, m_datasets.value(m_iptcTags.value(tag)))
+        value << this->value(range);
+    return true;
+}
+
+void Iptc::entries(const QList<QuillMetadata::Tag> &tags,
+                   QMap<QuillMetadata::Tag, QVariant> &result) const
+{
+    if (m_datasets.isEmpty())
+        return;
+
+    foreach (QuillMetadata::Tag tag, tags) {
+        QVariant value = entry(tag);
+        if (!value.isNull())
+            result.insert(tag, value);
+    }
+}
+
+void Iptc::setEntry(QuillMetadata::Tag tag, const QVariant &entry)
+{
+    Q_UNUSED(entry);
+
+    // The new value lives in XMP, forget the stale one
+    removeEntry(tag);
+}
+
+void Iptc::removeEntry(QuillMetadata::Tag tag)
+{
+    if (supportsEntry(tag))
+        m_datasets.remove(m_iptcTags.value(tag));
+}
+
+void Iptc::initTags()
+{
+    // The compiler guards the first call; later ones do not lock
+    static const bool isFilled = fillTags();
+    Q_UNUSED(isFilled);
+}
+
+bool Iptc::fillTags()
+{
+    m_iptcTags.insert(QuillMetadata::Tag_Title, 5);         // Object Name
+    m_iptcTags.insert(QuillMetadata::Tag_Subject, 25);      // Keywords
+    m_iptcTags.insert(QuillMetadata::Tag_Creator, 80);      // By-line
+    m_iptcTags.insert(QuillMetadata::Tag_City, 90);         // City
+    m_iptcTags.insert(QuillMetadata::Tag_Location, 92);     // Sub-location
+    m_iptcTags.insert(QuillMetadata::Tag_Country, 101);     // Country Name
+    m_iptcTags.insert(QuillMetadata::Tag_Description, 120); // Caption/Abstract
+
+    return true;
+}
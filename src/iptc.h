@@ -0,0 +1,101 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#ifndef IPTC_H
+#define IPTC_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QMap>
+#include <QList>
+
+#include "metadatarepresentation.h"
+
+/*!
+  Read-only IPTC-IIM metadata, as found in the Photoshop APP13 block
+  of legacy newswire images.
+
+  Datasets are only indexed when the block is read; values are decoded
+  from the block on request. The library does not write IPTC-IIM, it is
+  updated through XMP by the exempi reconciliation instead.
+ */
+
+class Iptc : public MetadataRepresentation
+{
+ public:
+    Iptc();
+    Iptc(const QByteArray &photoshopBlock);
+
+    bool isValid() const;
+
+    bool supportsEntry(QuillMetadata::Tag tag) const;
+    bool hasEntry(QuillMetadata::Tag tag) const;
+    QVariant entry(QuillMetadata::Tag tag) const;
+    bool entry(QuillMetadata::Tag tag, QString &value) const;
+    bool entry(QuillMetadata::Tag tag, QStringList &value) const;
+    void entries(const QList<QuillMetadata::Tag> &tags,
+                 QMap<QuillMetadata::Tag, QVariant> &result) const;
+    void setEntry(QuillMetadata::Tag tag, const QVariant &entry);
+    void removeEntry(QuillMetadata::Tag tag);
+
+ private:
+    struct Range {
+        int offset;
+        int size;
+    };
+
+    void initTags();
+    static bool fillTags();
+
+    void readDatasets(int pos, int end);
+
+    QString value(const Range &range) const;
+
+ private:
+    // Application record (2) dataset numbers by tag
+    static QHash<QuillMetadata::Tag,int> m_iptcTags;
+
+    QByteArray m_data;
+    // Application record datasets by number, in file order
+    QHash<int, QList<Range> > m_datasets;
+    bool m_isUtf8;
+
+};
+
+#endif
@@ -37,35 +37,142 @@
 **
 ****************************************************************************/
 
-#include <QImageReader>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QFutureInterface>
 
 #include "exif.h"
 #include "xmp.h"
+#include "iptc.h"
+#include "jpegheader.h"
+#include "bytesource.h"
 #include "quillmetadata.h"
+#include "quillmetadataprobe.h"
 
 class QuillMetadataPrivate
 {
 public:
     Xmp *xmp;
     Exif *exif;
+    Iptc *iptc;
     bool isXmpNeeded; // If in the writeback we need also write XMP metadata
+    QString fileName; // The file the metadata was read from, if any
+    // Whether the blocks differ from those in fileName
+    mutable bool isExifModified;
+    mutable bool isXmpModified;
+    // The blocks as read from fileName, kept from the first modification
+    mutable QByteArray originalExif;
+    mutable QByteArray originalXmp;
+    // Frame parameters of the file, read along with the metadata
+    JpegFrame frame;
 
-    static bool m_initialized;
     static QMap<QuillMetadata::TagGroup, QList<QuillMetadata::Tag> >
     m_tagGroups;
 };
 
-bool QuillMetadataPrivate::m_initialized = false;
 QMap<QuillMetadata::TagGroup, QList<QuillMetadata::Tag> >
   QuillMetadataPrivate::m_tagGroups;
 
+// Mostly waiting for storage, so a few threads of its own
+static const int IoThreadCount = 2;
+
+class QuillMetadataThreadPool : public QThreadPool
+{
+public:
+    QuillMetadataThreadPool() { setMaxThreadCount(IoThreadCount); }
+};
+
+Q_GLOBAL_STATIC(QuillMetadataThreadPool, ioThreadPool)
+
+/*!
+  A task of the I/O thread pool, reporting its result through a future.
+ */
+
+template <typename T>
+class QuillMetadataTask : public QRunnable
+{
+public:
+    QFuture<T> start()
+    {
+        m_result.reportStarted();
+        QFuture<T> future = m_result.future();
+        QuillMetadata::threadPool()->start(this);
+        return future;
+    }
+
+    void run()
+    {
+        if (!m_result.isCanceled())
+            m_result.reportResult(result());
+        m_result.reportFinished();
+    }
+
+protected:
+    virtual T result() = 0;
+
+private:
+    QFutureInterface<T> m_result;
+};
+
+class QuillMetadataReadTask : public QuillMetadataTask<QMap<QuillMetadata::Tag, QVariant> >
+{
+public:
+    QuillMetadataReadTask(const QString &filePath,
+                          QuillMetadata::MetadataFormatFlags formats,
+                          const QList<QuillMetadata::Tag> &tags) :
+        m_filePath(filePath), m_formats(formats), m_tags(tags) {}
+
+protected:
+    QMap<QuillMetadata::Tag, QVariant> result()
+    {
+        QuillMetadata metadata(m_filePath, m_formats);
+        return m_tags.isEmpty() ? metadata.allEntries() :
+            metadata.entries(m_tags);
+    }
+
+private:
+    QString m_filePath;
+    QuillMetadata::MetadataFormatFlags m_formats;
+    QList<QuillMetadata::Tag> m_tags;
+};
+
+class QuillMetadataWriteTask : public QuillMetadataTask<bool>
+{
+public:
+    QuillMetadataWriteTask(QuillMetadata *metadata, const QString &filePath,
+                           QuillMetadata::MetadataFormatFlags formats,
+                           QuillMetadata::WriteOptions options) :
+        m_metadata(metadata), m_filePath(filePath),
+        m_formats(formats), m_options(options) {}
+
+    ~QuillMetadataWriteTask() { delete m_metadata; }
+
+protected:
+    bool result()
+    {
+        return m_metadata->write(m_filePath, m_formats, m_options);
+    }
+
+private:
+    QuillMetadata *m_metadata;
+    QString m_filePath;
+    QuillMetadata::MetadataFormatFlags m_formats;
+    QuillMetadata::WriteOptions m_options;
+};
+
 QuillMetadata::QuillMetadata()
 {
     init();
     priv = new QuillMetadataPrivate;
     priv->xmp = new Xmp();
     priv->exif = new Exif();
+    priv->iptc = new Iptc();
     priv->isXmpNeeded = false;
+    priv->isExifModified = false;
+    priv->isXmpModified = false;
 }
 
 QuillMetadata::QuillMetadata(const QString &fileName,
@@ -73,15 +180,8 @@ QuillMetadata::QuillMetadata(const QString &fileName,
 {
     init();
     priv = new QuillMetadataPrivate;
-    if (formats == ExifFormat) {
-        priv->xmp = new Xmp();
-        priv->isXmpNeeded = false;
-    }
-    else {
-        priv->xmp = new Xmp(fileName);
-        priv->isXmpNeeded = true;
-    }
-    priv->exif = new Exif(fileName);
+    read(fileName, JpegHeader(QFile::encodeName(fileName).constData()), formats, Tag_Undefined,
+         ReadOption_None);
 }
 
 QuillMetadata::QuillMetadata(const QString &fileName,
@@ -90,57 +190,250 @@ QuillMetadata::QuillMetadata(const QString &fileName,
 {
     init();
     priv = new QuillMetadataPrivate;
-    if (formats == ExifFormat) {
+    read(fileName, JpegHeader(QFile::encodeName(fileName).constData()), formats, tagToRead, ReadOption_None);
+}
+
+QuillMetadata::QuillMetadata(const QString &fileName,
+                             MetadataFormatFlags formats,
+                             Tag tagToRead,
+                             ReadOptions options)
+{
+    init();
+    priv = new QuillMetadataPrivate;
+    read(fileName, JpegHeader(QFile::encodeName(fileName).constData()), formats, tagToRead, options);
+}
+
+QuillMetadata::QuillMetadata(const QuillMetadataProbe &probe,
+                             MetadataFormatFlags formats)
+{
+    init();
+    priv = new QuillMetadataPrivate;
+
+    // The probe already knows where the segments are
+    JpegHeader header = probe.header();
+    header.readPayloads(QFile::encodeName(probe.fileName()).constData());
+    read(probe.fileName(), header, formats, Tag_Undefined, ReadOption_None);
+}
+
+QuillMetadata::QuillMetadata(ByteSource &source,
+                             MetadataFormatFlags formats)
+{
+    init();
+    priv = new QuillMetadataPrivate;
+    read(QString(), JpegHeader(source), formats, Tag_Undefined,
+         ReadOption_None);
+}
+
+QuillMetadata::QuillMetadata(int fd, MetadataFormatFlags formats)
+{
+    init();
+    priv = new QuillMetadataPrivate;
+    FileByteSource source(fd);
+    read(QString(), JpegHeader(source), formats, Tag_Undefined,
+         ReadOption_None);
+}
+
+static QByteArray toByteArray(const std::string &data)
+{
+    return QByteArray(data.data(), data.size());
+}
+
+void QuillMetadata::read(const QString &fileName,
+                         const JpegHeader &header,
+                         MetadataFormatFlags formats,
+                         Tag tagToRead,
+                         ReadOptions options)
+{
+    // EXIF and IPTC blocks are found in a single pass over the header
+
+    if ((formats == ExifFormat) || (formats == IptcFormat)) {
         priv->xmp = new Xmp();
         priv->isXmpNeeded = false;
     }
     else {
-        priv->xmp = new Xmp(fileName);
+        // The packet is taken from the header already read, unless it
+        // is not a JPEG file or the packet continues in extended XMP
+        // segments, which exempi puts together from the file
+        const std::string signature("http://ns.adobe.com/xap/1.0/\0", 29);
+        if (fileName.isEmpty() ||
+            (header.isValid() &&
+             (header.position(JpegHeader::Marker_APP1,
+                              std::string("http://ns.adobe.com/xmp/extension/\0", 35)) < 0)))
+            priv->xmp = new Xmp(toByteArray(header.segment(JpegHeader::Marker_APP1,
+                                                           signature)).mid(signature.size()));
+        else
+            priv->xmp = new Xmp(fileName);
         priv->isXmpNeeded = true;
     }
-    priv->exif = new Exif(fileName, tagToRead);
+
+    if (formats == IptcFormat)
+        priv->exif = new Exif();
+    else
+        priv->exif = new Exif(toByteArray(header.segment(JpegHeader::Marker_APP1,
+                                                         std::string("Exif\0\0", 6))),
+                              tagToRead,
+                              options.testFlag(ReadOption_OpaqueMakerNote));
+
+    if (((formats == IptcFormat) || (formats == AllFormats)) &&
+        (tagToRead == Tag_Undefined))
+        priv->iptc = new Iptc(toByteArray(header.segment(JpegHeader::Marker_APP13,
+                                                         "Photoshop 3.0")));
+    else
+        priv->iptc = new Iptc();
+
+    priv->frame = header.frame();
+    priv->fileName = fileName;
+    priv->isExifModified = false;
+    priv->isXmpModified = false;
 }
 
 QuillMetadata::~QuillMetadata()
 {
     delete priv->xmp;
     delete priv->exif;
+    delete priv->iptc;
     delete priv;
 }
 
 bool QuillMetadata::canRead(const QString &filePath)
 {
-    QImageReader reader(filePath, "jpeg");
-    return reader.canRead();
+    return (QuillMetadataProbe(filePath).format() ==
+            QuillMetadataProbe::Format_Jpeg);
 }
 
 bool QuillMetadata::isValid() const
 {
-    return (priv->exif->isValid() || priv->xmp->isValid());
+    return (priv->exif->isValid() || priv->xmp->isValid() ||
+            priv->iptc->isValid());
 }
 
 QVariant QuillMetadata::entry(Tag tag) const
 {
-    // Prioritize EXIF over XMP as required by metadata working group
+    // Prioritize EXIF over XMP as required by metadata working group,
+    // and both over legacy IPTC-IIM
     QVariant result = priv->exif->entry(tag);
     if (result.isNull())
         result = priv->xmp->entry(tag);
+    if (result.isNull())
+        result = priv->iptc->entry(tag);
+
+    return result;
+}
+
+bool QuillMetadata::entry(Tag tag, int &value) const
+{
+    return (priv->exif->entry(tag, value) || priv->xmp->entry(tag, value));
+}
+
+bool QuillMetadata::entry(Tag tag, double &value) const
+{
+    return (priv->exif->entry(tag, value) || priv->xmp->entry(tag, value));
+}
+
+bool QuillMetadata::entry(Tag tag, QString &value) const
+{
+    return (priv->exif->entry(tag, value) || priv->xmp->entry(tag, value) ||
+            priv->iptc->entry(tag, value));
+}
+
+bool QuillMetadata::entry(Tag tag, QStringList &value) const
+{
+    // EXIF has no list-valued tags
+    return (priv->xmp->entry(tag, value) || priv->iptc->entry(tag, value));
+}
+
+bool QuillMetadata::entry(Tag tag, QDateTime &value) const
+{
+    return (priv->exif->entry(tag, value) || priv->xmp->entry(tag, value));
+}
+
+QMap<QuillMetadata::Tag, QVariant>
+QuillMetadata::entries(const QList<Tag> &tags) const
+{
+    QMap<Tag, QVariant> result;
+
+    // Prioritize EXIF over XMP as required by metadata working group
+    priv->exif->entries(tags, result);
+
+    QList<Tag> missingTags;
+    foreach (Tag tag, tags)
+        if (!result.contains(tag))
+            missingTags << tag;
+
+    if (!missingTags.isEmpty())
+        priv->xmp->entries(missingTags, result);
+
+    QList<Tag> iptcTags;
+    foreach (Tag tag, missingTags)
+        if (!result.contains(tag))
+            iptcTags << tag;
+
+    if (!iptcTags.isEmpty())
+        priv->iptc->entries(iptcTags, result);
 
     return result;
 }
 
+QMap<QuillMetadata::Tag, QVariant> QuillMetadata::allEntries() const
+{
+    QList<Tag> tags;
+    for (int tag = Tag_Make; tag < Tag_Undefined; tag++)
+        tags << (Tag)tag;
+
+    return entries(tags);
+}
+
 void QuillMetadata::setEntry(Tag tag, const QVariant &entry)
 {
+    setModified(tag);
     priv->exif->setEntry(tag, entry);
     priv->xmp->setEntry(tag, entry);
+    priv->iptc->setEntry(tag, entry);
     if (priv->xmp->supportsEntry(tag) && (tag != Tag_Orientation))
         priv->isXmpNeeded = true;
 }
 
 void QuillMetadata::removeEntry(Tag tag)
 {
+    setModified(tag);
     priv->exif->removeEntry(tag);
     priv->xmp->removeEntry(tag);
+    priv->iptc->removeEntry(tag);
+}
+
+void QuillMetadata::setModified(Tag tag)
+{
+    if (priv->exif->supportsEntry(tag))
+        setModified(ExifFormat);
+    if (priv->xmp->supportsEntry(tag))
+        setModified(XmpFormat);
+}
+
+void QuillMetadata::setModified(MetadataFormatFlags format)
+{
+    // Serialize the blocks as read before their first modification,
+    // so that write() can tell whether they have really changed
+    if ((format == ExifFormat) && !priv->isExifModified)
+        setModified(format, priv->fileName.isEmpty() ?
+                    QByteArray() : priv->exif->dump());
+    else if ((format == XmpFormat) && !priv->isXmpModified)
+        setModified(format, priv->fileName.isEmpty() ?
+                    QByteArray() : priv->xmp->dump());
+}
+
+void QuillMetadata::setModified(MetadataFormatFlags format,
+                                const QByteArray &original)
+{
+    if ((format == ExifFormat) && !priv->isExifModified) {
+        if (!priv->fileName.isEmpty())
+            priv->originalExif = original;
+        priv->isExifModified = true;
+    }
+    else if ((format == XmpFormat) && !priv->isXmpModified) {
+        if (!priv->fileName.isEmpty())
+            priv->originalXmp = original;
+        priv->isXmpModified = true;
+    }
 }
 
 void QuillMetadata::removeEntries(const QList<Tag> &tags)
@@ -151,6 +444,7 @@ void QuillMetadata::removeEntries(const QList<Tag> &tags)
 
 void QuillMetadata::removeEntries(TagGroup tagGroup)
 {
+    // Also marks the affected blocks as modified
     removeEntries(QuillMetadataPrivate::m_tagGroups.value(tagGroup));
     priv->exif->removeEntries(tagGroup);
 }
@@ -158,32 +452,295 @@ void QuillMetadata::removeEntries(TagGroup tagGroup)
 bool QuillMetadata::write(const QString &fileName,
                           MetadataFormatFlags formats) const
 {
+    return write(fileName, formats, WriteOption_None);
+}
+
+bool QuillMetadata::write(const QString &fileName,
+                          MetadataFormatFlags formats,
+                          WriteOptions options) const
+{
+    bool isExifSelected = (formats == ExifFormat) || (formats == AllFormats);
+    bool isXmpSelected = ((formats == XmpFormat) || (formats == AllFormats)) &&
+        priv->isXmpNeeded;
+
+    // Blocks which have not changed since they were read from the
+    // same file need not be written back
+    bool isSourceFile = isSameFile(priv->fileName, fileName);
+    if (isSourceFile) {
+        if (isExifSelected && priv->isExifModified &&
+            (priv->exif->dump() == priv->originalExif))
+            priv->isExifModified = false;
+        if (isXmpSelected && priv->isXmpModified &&
+            (priv->xmp->dump() == priv->originalXmp))
+            priv->isXmpModified = false;
+    }
+
+    bool generateThumbnail = isExifSelected &&
+        options.testFlag(WriteOption_GenerateThumbnail) &&
+        !priv->exif->hasThumbnail();
+
+    bool writeExif = isExifSelected &&
+        (!isSourceFile || priv->isExifModified || generateThumbnail);
+    // The EXIF writeback drops the XMP block, restore it
+    bool writeXmp = isXmpSelected &&
+        (!isSourceFile || priv->isXmpModified || writeExif);
+
     bool result = true;
-    if ((formats == ExifFormat) || (formats == AllFormats))
-        result = result && priv->exif->write(fileName);
-    if (((formats == XmpFormat) || (formats == AllFormats)) &&
-        priv->isXmpNeeded)
+    if (writeExif)
+        result = result && priv->exif->write(fileName, generateThumbnail);
+    if (writeXmp)
         result = result && priv->xmp->write(fileName);
+
+    if (result && isSourceFile) {
+        if (writeExif) {
+            priv->isExifModified = false;
+            priv->originalExif.clear();
+        }
+        if (writeXmp) {
+            priv->isXmpModified = false;
+            priv->originalXmp.clear();
+        }
+    }
+    return result;
+}
+
+bool QuillMetadata::write(int fd, MetadataFormatFlags formats,
+                          WriteOptions options) const
+{
+    bool isExifSelected = (formats == ExifFormat) || (formats == AllFormats);
+    bool isXmpSelected = ((formats == XmpFormat) || (formats == AllFormats)) &&
+        priv->isXmpNeeded;
+
+    bool generateThumbnail = isExifSelected &&
+        options.testFlag(WriteOption_GenerateThumbnail) &&
+        !priv->exif->hasThumbnail();
+
+    // The EXIF writeback drops the XMP block, which is written after it
+    bool result = true;
+    if (isExifSelected)
+        result = result && priv->exif->write(fd, generateThumbnail);
+    if (isXmpSelected)
+        result = result && priv->xmp->write(fd);
     return result;
 }
 
+QFuture<QMap<QuillMetadata::Tag, QVariant> >
+QuillMetadata::readAsync(const QString &filePath,
+                         MetadataFormatFlags formats,
+                         const QList<Tag> &tags)
+{
+    return (new QuillMetadataReadTask(filePath, formats, tags))->start();
+}
+
+QFuture<bool> QuillMetadata::writeAsync(const QString &filePath,
+                                        MetadataFormatFlags formats,
+                                        WriteOptions options) const
+{
+    return (new QuillMetadataWriteTask(snapshot(), filePath,
+                                       formats, options))->start();
+}
+
+QThreadPool *QuillMetadata::threadPool()
+{
+    return ioThreadPool();
+}
+
+QuillMetadata *QuillMetadata::snapshot() const
+{
+    // The blocks are serialized, so that the copy shares no parser state
+    QuillMetadata *copy = new QuillMetadata;
+    const QByteArray exif = priv->exif->dump();
+    if (!exif.isEmpty())
+        copy->priv->exif->load(exif);
+    const QByteArray xmp = priv->xmp->dump();
+    if (!xmp.isEmpty())
+        copy->priv->xmp->load(xmp);
+
+    copy->priv->isXmpNeeded = priv->isXmpNeeded;
+    copy->priv->fileName = priv->fileName;
+    copy->priv->isExifModified = priv->isExifModified;
+    copy->priv->isXmpModified = priv->isXmpModified;
+    copy->priv->originalExif = priv->originalExif;
+    copy->priv->originalXmp = priv->originalXmp;
+    copy->priv->frame = priv->frame;
+
+    return copy;
+}
+
+bool QuillMetadata::isSameFile(const QString &fileName,
+                               const QString &otherFileName)
+{
+    if (fileName.isEmpty() || otherFileName.isEmpty())
+        return false;
+
+    const QString canonicalPath = QFileInfo(fileName).canonicalFilePath();
+    return !canonicalPath.isEmpty() &&
+        (canonicalPath == QFileInfo(otherFileName).canonicalFilePath());
+}
+
 QByteArray QuillMetadata::dump(MetadataFormatFlags formats) const
 {
     if (formats == ExifFormat)
         return priv->exif->dump();
+    else if (formats == XmpFormat)
+        return priv->xmp->dump();
     else
         return QByteArray();
 }
 
-void QuillMetadata::init()
+QSize QuillMetadata::imageSize() const
+{
+    if (!priv->frame.isValid())
+        return QSize();
+
+    return QSize(priv->frame.width, priv->frame.height);
+}
+
+int QuillMetadata::componentCount() const
+{
+    return priv->frame.components;
+}
+
+bool QuillMetadata::isProgressive() const
+{
+    return priv->frame.isProgressive;
+}
+
+QList<QSize> QuillMetadata::samplingFactors() const
+{
+    QList<QSize> factors;
+    for (size_t i = 0; i < priv->frame.samplingFactors.size(); i++)
+        factors.append(QSize(priv->frame.samplingFactors[i].horizontal,
+                             priv->frame.samplingFactors[i].vertical));
+    return factors;
+}
+
+QByteArray QuillMetadata::thumbnail() const
+{
+    return priv->exif->thumbnail();
+}
+
+QSize QuillMetadata::thumbnailSize() const
+{
+    const QByteArray thumbnail = priv->exif->thumbnail();
+    if (thumbnail.isEmpty())
+        return QSize();
+
+    const JpegFrame frame =
+        JpegHeader(thumbnail.constData(), thumbnail.size()).frame();
+    if (!frame.isValid())
+        return QSize();
+
+    return QSize(frame.width, frame.height);
+}
+
+bool QuillMetadata::loadFromData(const QByteArray &data,
+                                 MetadataFormatFlags format)
+{
+    // The blocks as read are serialized first, but the object is only
+    // marked as modified once the new block has been parsed
+    if (format == ExifFormat) {
+        const QByteArray original = priv->exif->dump();
+        if (!priv->exif->load(data))
+            return false;
+        setModified(ExifFormat, original);
+        return true;
+    }
+    else if (format == XmpFormat) {
+        const QByteArray original = priv->xmp->dump();
+        if (!priv->xmp->load(data))
+            return false;
+        setModified(XmpFormat, original);
+        priv->isXmpNeeded = true;
+        return true;
+    }
+    else
+        return false;
+}
+
+QString QuillMetadata::sidecarPath(const QString &filePath)
+{
+    QFileInfo info(filePath);
+    return QDir(info.path()).filePath(info.completeBaseName() + ".xmp");
+}
+
+bool QuillMetadata::readSidecar(const QString &sidecarPath,
+                                SidecarPrecedence precedence)
+{
+    QString path = sidecarPath;
+    if (path.isEmpty()) {
+        if (priv->fileName.isEmpty())
+            return false;
+        path = QuillMetadata::sidecarPath(priv->fileName);
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    Xmp sidecar;
+    if (!sidecar.load(file.readAll()))
+        return false;
+
+    for (int i = Tag_Make; i < Tag_Undefined; i++) {
+        Tag tag = (Tag)i;
+        if (!sidecar.supportsEntry(tag))
+            continue;
+
+        // XMP stores the GPS references inside the coordinate properties;
+        // they are folded into the sign of the coordinate below, since
+        // setting them on their own would overwrite the coordinate.
+        if ((tag == Tag_GPSLatitudeRef) || (tag == Tag_GPSLongitudeRef) ||
+            (tag == Tag_GPSAltitudeRef))
+            continue;
+
+        QVariant value = sidecar.entry(tag);
+        if (value.isNull())
+            continue;
+        if ((precedence == SidecarPrecedence_Embedded) && !entry(tag).isNull())
+            continue;
+
+        bool isNegative = false;
+        if (tag == Tag_GPSLatitude)
+            isNegative = (sidecar.entry(Tag_GPSLatitudeRef).toString() == "S");
+        else if (tag == Tag_GPSLongitude)
+            isNegative = (sidecar.entry(Tag_GPSLongitudeRef).toString() == "W");
+        else if (tag == Tag_GPSAltitude)
+            isNegative = (sidecar.entry(Tag_GPSAltitudeRef).toInt() == 1);
+
+        if (isNegative)
+            value = QVariant(-value.toDouble());
+
+        setEntry(tag, value);
+    }
+
+    return true;
+}
+
+bool QuillMetadata::writeSidecar(const QString &sidecarPath) const
 {
-    if (QuillMetadataPrivate::m_initialized)
-        return;
+    QString path = sidecarPath;
+    if (path.isEmpty()) {
+        if (priv->fileName.isEmpty())
+            return false;
+        path = QuillMetadata::sidecarPath(priv->fileName);
+    }
 
-    QuillMetadataPrivate::m_initialized = true;
+    QByteArray packet = priv->xmp->dump();
+    if (packet.isEmpty())
+        return false;
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    return (file.write(packet) == packet.size());
+}
 
+static bool fillTagGroups()
+{
     QuillMetadataPrivate::m_tagGroups.insert(
-      TagGroup_GPS,
+      QuillMetadata::TagGroup_GPS,
       QList<QuillMetadata::Tag>() <<
       QuillMetadata::Tag_GPSLatitude <<
       QuillMetadata::Tag_GPSLatitudeRef <<
@@ -194,4 +751,13 @@ void QuillMetadata::init()
       QuillMetadata::Tag_GPSImgDirection <<
       QuillMetadata::Tag_GPSImgDirectionRef <<
       QuillMetadata::Tag_GPSVersionID);
+
+    return true;
+}
+
+void QuillMetadata::init()
+{
+    // Filled once, by whichever thread creates the first object
+    static const bool isFilled = fillTagGroups();
+    Q_UNUSED(isFilled);
 }
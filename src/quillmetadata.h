@@ -72,10 +72,19 @@ QuillMetadata::Tag for a complete list of supported tags.
 #define QUILL_METADATA_H
 
 #include <QString>
+#include <QStringList>
+#include <QDateTime>
 #include <QVariant>
+#include <QMap>
+#include <QSize>
+#include <QFuture>
 #include "quillmetadataregionlist.h"
 
+class QThreadPool;
 class QuillMetadataPrivate;
+class QuillMetadataProbe;
+class JpegHeader;
+class ByteSource;
 
 
 class QuillMetadata
@@ -87,9 +96,9 @@ class QuillMetadata
         Tag_Make,
         //! Camera model, string (EXIF)
         Tag_Model,
-        //! Image width, int (EXIF, deprecated)
+        //! Image width, int (EXIF, deprecated, see imageSize())
         Tag_ImageWidth,
-        //! Image height, int (EXIF, deprecated)
+        //! Image height, int (EXIF, deprecated, see imageSize())
         Tag_ImageHeight,
         //! Camera focal length, float (EXIF)
         Tag_FocalLength,
@@ -162,10 +171,58 @@ class QuillMetadata
         ExifFormat = 0x1,
         //! Operate on XMP only
         XmpFormat = 0x2,
+        //! Operate on IPTC-IIM only (reading without exempi)
+        IptcFormat = 0x4,
         //! Operate on all formats
         AllFormats = ~1
     };
 
+    /*!
+      Options changing how metadata is read from a file.
+     */
+
+    enum ReadOption {
+        //! Read and interpret all metadata
+        ReadOption_None = 0x0,
+        //! Do not interpret the vendor MakerNote of the EXIF block but
+        //! keep it as an opaque blob, written back byte for byte
+        ReadOption_OpaqueMakerNote = 0x1
+    };
+    Q_DECLARE_FLAGS(ReadOptions, ReadOption)
+
+    /*!
+      Options changing how metadata is written into a file.
+     */
+
+    enum WriteOption {
+        //! Write the metadata as it is
+        WriteOption_None = 0x0,
+        //! Embed a thumbnail into the EXIF block if it has none,
+        //! generated from the image without fully decoding it
+        WriteOption_GenerateThumbnail = 0x1
+    };
+    Q_DECLARE_FLAGS(WriteOptions, WriteOption)
+
+    /*!
+      Which values win when an XMP sidecar is merged into metadata
+      read from a file, see readSidecar().
+     */
+
+    enum SidecarPrecedence {
+        //! Values in the sidecar replace those in the file
+        SidecarPrecedence_Sidecar,
+        //! Values in the sidecar are only used for entries missing in the file
+        SidecarPrecedence_Embedded
+    };
+
+    /*!
+      Compile-time value type of a tag, used by typedEntry(). Only
+      tags with a well-defined scalar or list representation have
+      traits; see the specializations below the class.
+     */
+
+    template <Tag tag> struct TagTraits;
+
  public:
     /*!
       Constructs an empty metadata object.
@@ -177,8 +234,9 @@ class QuillMetadata
 
       @param filePath Local filesystem path to file to be read.
 
-      @param formats Which formats to read (currently only supports ExifFormat
-      and AllFormats)
+      @param formats Which formats to read (currently only supports ExifFormat,
+      IptcFormat and AllFormats). IPTC-IIM is read natively from the APP13
+      block; with IptcFormat, exempi is not used at all.
      */
 
     QuillMetadata(const QString &fileName,
@@ -199,6 +257,71 @@ class QuillMetadata
                   MetadataFormatFlags formats,
                   Tag tagToRead);
 
+    /*!
+      Constructs a metadata object containing all metadata from a given file.
+
+      @param filePath Local filesystem path to file to be read.
+
+      @param formats Which formats to read (currently only supports ExifFormat,
+      IptcFormat and AllFormats)
+
+      @param tagToRead Which tags to read; if undefined, reads all tags
+
+      @param options How to read the metadata. ReadOption_OpaqueMakerNote
+      saves the time spent interpreting vendor MakerNotes, which are
+      never exposed as entries.
+     */
+
+    QuillMetadata(const QString &fileName,
+                  MetadataFormatFlags formats,
+                  Tag tagToRead,
+                  ReadOptions options);
+
+    /*!
+      Constructs a metadata object containing all metadata from a
+      probed file. The metadata blocks are read from the positions
+      found by the probe, without scanning the file header again.
+
+      @param probe The probe of the file to be read.
+
+      @param formats Which formats to read, see above.
+     */
+
+    explicit QuillMetadata(const QuillMetadataProbe &probe,
+                           MetadataFormatFlags formats = AllFormats);
+
+    /*!
+      Constructs a metadata object containing all metadata from a byte
+      source of the core library, e.g. an image in memory or in remote
+      storage. Only the header of the image is read from the source.
+
+      Extended XMP is not read from a source, and the object has no
+      file name to write back to.
+
+      @param source The source of a JPEG image.
+
+      @param formats Which formats to read, see above.
+     */
+
+    explicit QuillMetadata(ByteSource &source,
+                           MetadataFormatFlags formats = AllFormats);
+
+    /*!
+      Constructs a metadata object containing all metadata from an open
+      file, e.g. one passed from another process or a memfd. The file
+      is read with pread(), so its offset is left as it is, and it is
+      never opened again by name. The descriptor is not closed.
+
+      Extended XMP is not read from a descriptor.
+
+      @param fd A file descriptor open for reading.
+
+      @param formats Which formats to read, see above.
+     */
+
+    explicit QuillMetadata(int fd,
+                           MetadataFormatFlags formats = AllFormats);
+
     /*!
       Removes a metadata object.
      */
@@ -208,7 +331,8 @@ class QuillMetadata
       Returns true if the image format of a given file is supported by
       the metadata reader. It will only make a lightweight check of
       the file headers, and it will not guarantee that any metadata can
-      be actually be read from the file.
+      be actually be read from the file. Use QuillMetadataProbe for
+      details about the file.
      */
 
     static bool canRead(const QString &filePath);
@@ -220,10 +344,46 @@ class QuillMetadata
 
     /*!
       Returns the value of the metadata entry for a given tag.
-      Currently, only some tags are supported.
+      Currently, only some tags are supported. EXIF is prioritized
+      over XMP, and both over IPTC-IIM.
      */
     QVariant entry(Tag tag) const;
 
+    /*!
+      Reads the value of a metadata entry directly into a native type,
+      without going through QVariant. EXIF is prioritized over XMP in
+      the same way as in entry().
+
+      @return true if the entry exists and could be converted.
+     */
+    bool entry(Tag tag, int &value) const;
+    bool entry(Tag tag, double &value) const;
+    bool entry(Tag tag, QString &value) const;
+    bool entry(Tag tag, QStringList &value) const;
+    bool entry(Tag tag, QDateTime &value) const;
+
+    /*!
+      Returns the value of a metadata entry in the type given by
+      TagTraits, e.g. typedEntry<Tag_Orientation>() returns an int.
+      A default-constructed value is returned if the entry is missing;
+      use the entry(Tag, T &) overloads to tell the two cases apart.
+     */
+    template <Tag tag>
+    typename TagTraits<tag>::ValueType typedEntry() const;
+
+    /*!
+      Returns the values of several metadata entries at once. EXIF and
+      XMP are both traversed only once, and EXIF is prioritized over
+      XMP in the same way as in entry(). Tags without a value are not
+      included in the result.
+     */
+    QMap<Tag, QVariant> entries(const QList<Tag> &tags) const;
+
+    /*!
+      Returns the values of all supported metadata entries, see entries().
+     */
+    QMap<Tag, QVariant> allEntries() const;
+
     /*!
       Sets the value of the metadata entry for a given tag. Use
       invalid QVariant to clear the entry. Currently, only some tags are
@@ -265,24 +425,245 @@ class QuillMetadata
       existing Exif blocks in the file except those affected by
       automated reconciliation. XmpFormat and AllFormats also include
       IPTC-IIM reconciliation.
+
+      When writing into the file the metadata was read from, blocks
+      which have not been modified since, or which would be written
+      back unchanged, are left untouched. The file is not written at
+      all if no block has changed.
      */
     bool write(const QString &filePath,
                MetadataFormatFlags formats = AllFormats) const;
 
     /*!
-      Dumps an EXIF or XMP block into a byte array.
+      Writes the metadata object into an existing file, see above.
+
+      @param options How to write the metadata. With
+      WriteOption_GenerateThumbnail, a thumbnail of at most 160 pixels
+      is built from the DC coefficients of the image, i.e. at 1/8 scale
+      without decoding the image in full, and embedded into the EXIF
+      block unless it already has one, compressed or not. Thumbnails
+      which would not fit into the EXIF block are left out.
+     */
+    bool write(const QString &filePath, MetadataFormatFlags formats,
+               WriteOptions options) const;
+
+    /*!
+      Writes the metadata object into an open file, see above. The file
+      is read and written with pread() and pwrite() and truncated to its
+      new size; it is never opened by name. As the descriptor cannot be
+      told apart from the file the metadata was read from, all selected
+      blocks are written.
+
+      @param fd A file descriptor open for reading and writing.
+     */
+    bool write(int fd, MetadataFormatFlags formats = AllFormats,
+               WriteOptions options = WriteOption_None) const;
+
+    /*!
+      Reads metadata entries from a file in the background, see
+      threadPool(). The future gives the same result as entries() on
+      a metadata object constructed from the file.
+
+      @param tags The tags to read; all supported tags if empty.
+     */
+    static QFuture<QMap<Tag, QVariant> >
+    readAsync(const QString &filePath,
+              MetadataFormatFlags formats = AllFormats,
+              const QList<Tag> &tags = QList<Tag>());
+
+    /*!
+      Writes the metadata object into an existing file in the
+      background, see write() and threadPool(). The metadata is copied
+      when the write is started, so the object can be modified or
+      destroyed right away. Writes of the same file should not overlap.
+
+      The future gives the result of write(). Unlike write(), it does
+      not mark the object as saved; a later write() to the same file
+      writes it again.
+     */
+    QFuture<bool> writeAsync(const QString &filePath,
+                             MetadataFormatFlags formats = AllFormats,
+                             WriteOptions options = WriteOption_None) const;
+
+    /*!
+      Returns the thread pool running readAsync() and writeAsync(). It
+      is separate from the global pool, as the tasks mostly wait for
+      file I/O, and its size can be adjusted to the storage.
+     */
+    static QThreadPool *threadPool();
+
+    /*!
+      Returns the path of the XMP sidecar of a given file: the file
+      name with its last extension replaced by ".xmp".
+     */
+
+    static QString sidecarPath(const QString &filePath);
+
+    /*!
+      Merges the entries of an XMP sidecar file into the metadata
+      object. Merged entries count as modified, so that a later write()
+      embeds them into the file.
+
+      @param sidecarPath Local filesystem path of the sidecar. If empty,
+      the sidecar of the file the metadata was read from is used.
+
+      @param precedence Whether sidecar or embedded values win for
+      entries present in both.
+
+      @return true if the sidecar could be read and parsed.
+     */
+
+    bool readSidecar(const QString &sidecarPath = QString(),
+                     SidecarPrecedence precedence = SidecarPrecedence_Sidecar);
+
+    /*!
+      Writes the XMP metadata into a sidecar file, leaving the image
+      file untouched. Any existing sidecar is overwritten.
+
+      @param sidecarPath Local filesystem path of the sidecar. If empty,
+      the sidecar of the file the metadata was read from is used.
+     */
+
+    bool writeSidecar(const QString &sidecarPath = QString()) const;
+
+    /*!
+      Dumps an EXIF or XMP block into a byte array. The block is
+      serialized once and shared by all dumps until the next
+      modification.
 
-      @param formats Which metadata block to dump. Currently only
-      supports ExifFormat, other format flags will return an empty
+      @param formats Which metadata block to dump, either ExifFormat
+      (an APP1 Exif block without the marker) or XmpFormat (a
+      serialized XMP packet). Other format flags will return an empty
       byte array.
      */
     QByteArray dump(MetadataFormatFlags formats) const;
 
+    /*!
+      Replaces an EXIF or XMP block with one dumped by dump(), possibly
+      by another metadata object.
+
+      @param data The block to load.
+
+      @param format Which metadata block is given, either ExifFormat or
+      XmpFormat.
+
+      @return true if the block could be parsed. The metadata object is
+      left unchanged otherwise.
+     */
+    bool loadFromData(const QByteArray &data, MetadataFormatFlags format);
+
+    /*!
+      Returns the pixel dimensions of the image, read from the JPEG
+      start of frame segment in the same pass as the metadata. Unlike
+      Tag_ImageWidth and Tag_ImageHeight, which depend on the EXIF
+      block, this is always the true size of the image. An invalid size
+      is returned if the object was not read from a JPEG file.
+     */
+    QSize imageSize() const;
+
+    /*!
+      Returns the number of color components of the image, e.g. 1 for
+      grayscale and 3 for YCbCr, or 0 if unknown.
+     */
+    int componentCount() const;
+
+    /*!
+      Returns true if the image is progressive rather than sequential
+      (baseline).
+     */
+    bool isProgressive() const;
+
+    /*!
+      Returns the horizontal and vertical sampling factors of each
+      component of the image, e.g. (2, 2), (1, 1), (1, 1) for 4:2:0
+      chroma subsampling.
+     */
+    QList<QSize> samplingFactors() const;
+
+    /*!
+      Returns the JPEG thumbnail embedded in IFD1 of the EXIF block, or
+      an empty byte array if there is none. The thumbnail is not
+      copied or re-encoded: the result refers to the EXIF block as it
+      was read, and is valid only as long as the metadata object
+      exists and no other block is loaded into it.
+
+      The thumbnail is also available when only a single tag has been
+      read, e.g. with Tag_Orientation.
+     */
+    QByteArray thumbnail() const;
+
+    /*!
+      Returns the pixel dimensions of the embedded thumbnail, or an
+      invalid size if there is none.
+     */
+    QSize thumbnailSize() const;
+
  private:
     void init();
 
+    void read(const QString &fileName, const JpegHeader &header,
+              MetadataFormatFlags formats, Tag tagToRead, ReadOptions options);
+
+    void setModified(Tag tag);
+
+    void setModified(MetadataFormatFlags format);
+
+    void setModified(MetadataFormatFlags format, const QByteArray &original);
+
+    static bool isSameFile(const QString &fileName,
+                           const QString &otherFileName);
+
+    QuillMetadata *snapshot() const;
+
  private:
     QuillMetadataPrivate *priv;
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(QuillMetadata::ReadOptions)
+Q_DECLARE_OPERATORS_FOR_FLAGS(QuillMetadata::WriteOptions)
+
+#define QUILL_METADATA_TAG_TRAITS(TAG, TYPE) \
+    template <> struct QuillMetadata::TagTraits<QuillMetadata::TAG> { \
+        typedef TYPE ValueType; \
+    }
+
+QUILL_METADATA_TAG_TRAITS(Tag_Make, QString);
+QUILL_METADATA_TAG_TRAITS(Tag_Model, QString);
+QUILL_METADATA_TAG_TRAITS(Tag_ImageWidth, int);
+QUILL_METADATA_TAG_TRAITS(Tag_ImageHeight, int);
+QUILL_METADATA_TAG_TRAITS(Tag_FocalLength, double);
+QUILL_METADATA_TAG_TRAITS(Tag_ExposureTime, double);
+QUILL_METADATA_TAG_TRAITS(Tag_TimestampOriginal, QDateTime);
+QUILL_METADATA_TAG_TRAITS(Tag_Title, QString);
+QUILL_METADATA_TAG_TRAITS(Tag_Creator, QString);
+QUILL_METADATA_TAG_TRAITS(Tag_Subject, QStringList);
+QUILL_METADATA_TAG_TRAITS(Tag_City, QString);
+QUILL_METADATA_TAG_TRAITS(Tag_Country, QString);
+QUILL_METADATA_TAG_TRAITS(Tag_Location, QString);
+QUILL_METADATA_TAG_TRAITS(Tag_Rating, double);
+QUILL_METADATA_TAG_TRAITS(Tag_Timestamp, QDateTime);
+QUILL_METADATA_TAG_TRAITS(Tag_Orientation, int);
+QUILL_METADATA_TAG_TRAITS(Tag_Description, QString);
+QUILL_METADATA_TAG_TRAITS(Tag_GPSLatitude, double);
+QUILL_METADATA_TAG_TRAITS(Tag_GPSLatitudeRef, QString);
+QUILL_METADATA_TAG_TRAITS(Tag_GPSLongitude, double);
+QUILL_METADATA_TAG_TRAITS(Tag_GPSLongitudeRef, QString);
+QUILL_METADATA_TAG_TRAITS(Tag_GPSAltitude, double);
+QUILL_METADATA_TAG_TRAITS(Tag_GPSAltitudeRef, int);
+QUILL_METADATA_TAG_TRAITS(Tag_GPSVersionID, QString);
+QUILL_METADATA_TAG_TRAITS(Tag_GPSImgDirection, double);
+QUILL_METADATA_TAG_TRAITS(Tag_GPSImgDirectionRef, QString);
+
+#undef QUILL_METADATA_TAG_TRAITS
+
+template <QuillMetadata::Tag tag>
+inline typename QuillMetadata::TagTraits<tag>::ValueType
+QuillMetadata::typedEntry() const
+{
+    typename TagTraits<tag>::ValueType value =
+        typename TagTraits<tag>::ValueType();
+    entry(tag, value);
+    return value;
+}
+
 #endif
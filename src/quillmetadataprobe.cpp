@@ -0,0 +1,162 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#include <QFile>
+#include "quillmetadataprobe.h"
+#include "jpegheader.h"
+#include "jpegbatchreader.h"
+
+class QuillMetadataProbePrivate : public QSharedData
+{
+public:
+    QuillMetadataProbePrivate(const QString &fileName) :
+        fileName(fileName),
+        header(std::string(QFile::encodeName(fileName).constData()),
+               JpegHeader::ReadMode_Structure) {}
+
+    QuillMetadataProbePrivate(const QString &fileName,
+                              const JpegHeader &header) :
+        fileName(fileName), header(header) {}
+
+    static JpegHeader::Marker marker(QuillMetadataProbe::Block block);
+    static std::string signature(QuillMetadataProbe::Block block);
+
+    QString fileName;
+    JpegHeader header;
+};
+
+JpegHeader::Marker QuillMetadataProbePrivate::marker(QuillMetadataProbe::Block block)
+{
+    switch (block) {
+    case QuillMetadataProbe::Block_Iptc:
+        return JpegHeader::Marker_APP13;
+    case QuillMetadataProbe::Block_Icc:
+        return JpegHeader::Marker_APP2;
+    default:
+        return JpegHeader::Marker_APP1;
+    }
+}
+
+std::string QuillMetadataProbePrivate::signature(QuillMetadataProbe::Block block)
+{
+    switch (block) {
+    case QuillMetadataProbe::Block_Exif:
+        return std::string("Exif\0\0", 6);
+    case QuillMetadataProbe::Block_Xmp:
+        return std::string("http://ns.adobe.com/xap/1.0/\0", 29);
+    case QuillMetadataProbe::Block_Iptc:
+        return std::string("Photoshop 3.0\0", 14);
+    case QuillMetadataProbe::Block_Icc:
+        return std::string("ICC_PROFILE\0", 12);
+    }
+    return std::string();
+}
+
+QuillMetadataProbe::QuillMetadataProbe(const QString &fileName)
+{
+    d = new QuillMetadataProbePrivate(fileName);
+}
+
+QuillMetadataProbe::QuillMetadataProbe(const QString &fileName,
+                                       const JpegHeader &header)
+{
+    d = new QuillMetadataProbePrivate(fileName, header);
+}
+
+QuillMetadataProbe::QuillMetadataProbe(const QuillMetadataProbe &other)
+    :d(other.d)
+{
+}
+
+QuillMetadataProbe::~QuillMetadataProbe()
+{
+}
+
+QuillMetadataProbe &QuillMetadataProbe::operator=(const QuillMetadataProbe &other)
+{
+    d = other.d;
+    return *this;
+}
+
+QList<QuillMetadataProbe> QuillMetadataProbe::probe(const QStringList &fileNames)
+{
+    std::vector<std::string> paths;
+    paths.reserve(fileNames.size());
+    foreach (const QString &fileName, fileNames)
+        paths.push_back(QFile::encodeName(fileName).constData());
+
+    const std::vector<JpegHeader> headers = JpegBatchReader().read(paths);
+
+    QList<QuillMetadataProbe> probes;
+    for (int i = 0; i < fileNames.size(); i++)
+        probes.append(QuillMetadataProbe(fileNames[i], headers[i]));
+    return probes;
+}
+
+QString QuillMetadataProbe::fileName() const
+{
+    return d->fileName;
+}
+
+QuillMetadataProbe::Format QuillMetadataProbe::format() const
+{
+    return d->header.isValid() ? Format_Jpeg : Format_Unknown;
+}
+
+bool QuillMetadataProbe::hasBlock(Block block) const
+{
+    return (blockOffset(block) >= 0);
+}
+
+qint64 QuillMetadataProbe::blockOffset(Block block) const
+{
+    return d->header.position(QuillMetadataProbePrivate::marker(block),
+                              QuillMetadataProbePrivate::signature(block));
+}
+
+int QuillMetadataProbe::blockSize(Block block) const
+{
+    return d->header.size(QuillMetadataProbePrivate::marker(block),
+                          QuillMetadataProbePrivate::signature(block));
+}
+
+JpegHeader QuillMetadataProbe::header() const
+{
+    return d->header;
+}
@@ -0,0 +1,143 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#ifndef QUILLMETADATAPROBE_H
+#define QUILLMETADATAPROBE_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QSharedDataPointer>
+
+class QuillMetadataProbePrivate;
+class JpegHeader;
+
+/*!
+  A lightweight check of the structure of an image file.
+
+  The probe reads the markers of a JPEG file up to the start of the
+  image data, skipping over the segment payloads, and tells which
+  metadata blocks the file has and where. No image decoder is involved.
+  A QuillMetadata object constructed from the probe reads the metadata
+  blocks found by the probe without scanning the file again.
+ */
+
+class QuillMetadataProbe
+{
+    friend class QuillMetadata;
+public:
+    enum Format {
+        //! Not a supported image file
+        Format_Unknown,
+        //! A JPEG file
+        Format_Jpeg
+    };
+
+    enum Block {
+        //! EXIF in an APP1 segment
+        Block_Exif,
+        //! XMP in an APP1 segment
+        Block_Xmp,
+        //! IPTC-IIM in an APP13 segment
+        Block_Iptc,
+        //! ICC color profile in APP2 segments
+        Block_Icc
+    };
+
+    /*!
+      Probes a given file.
+
+      @param fileName Local filesystem path to the file.
+     */
+    explicit QuillMetadataProbe(const QString &fileName);
+    QuillMetadataProbe(const QuillMetadataProbe &other);
+    ~QuillMetadataProbe();
+
+    QuillMetadataProbe &operator=(const QuillMetadataProbe &other);
+
+    /*!
+      Probes many files at once, reading the headers together with their
+      metadata blocks. Where the system supports it, the files are read
+      with many requests in flight, which is much faster than probing
+      them one by one on slow or remote storage. A QuillMetadata object
+      constructed from one of the probes does not access the file again.
+
+      @param fileNames Local filesystem paths to the files.
+
+      @return The probes, in the order of the files.
+     */
+    static QList<QuillMetadataProbe> probe(const QStringList &fileNames);
+
+    /*!
+      Returns the path of the probed file.
+     */
+    QString fileName() const;
+
+    /*!
+      Returns the image format of the file.
+     */
+    Format format() const;
+
+    /*!
+      Returns true if the file has a given metadata block.
+     */
+    bool hasBlock(Block block) const;
+
+    /*!
+      Returns the position of a metadata block in the file, i.e. of the
+      payload of its segment, or -1 if the file has no such block. For
+      a profile split into several segments, the first one is given.
+     */
+    qint64 blockOffset(Block block) const;
+
+    /*!
+      Returns the size of a metadata block in bytes, or -1 if the file
+      has no such block.
+     */
+    int blockSize(Block block) const;
+
+private:
+    QuillMetadataProbe(const QString &fileName, const JpegHeader &header);
+
+    JpegHeader header() const;
+
+    QSharedDataPointer<QuillMetadataProbePrivate> d;
+};
+
+#endif // QUILLMETADATAPROBE_H
@@ -0,0 +1,116 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#include <QSet>
+#include <QMutex>
+#include <QMutexLocker>
+#include "quillmetadatastringpool.h"
+
+class QuillMetadataStringPoolPrivate
+{
+public:
+    QuillMetadataStringPoolPrivate() : isEnabled(false) {}
+
+    QMutex mutex;
+    QSet<QString> strings;
+    bool isEnabled;
+};
+
+Q_GLOBAL_STATIC(QuillMetadataStringPoolPrivate, pool)
+
+void QuillMetadataStringPool::setEnabled(bool enabled)
+{
+    QMutexLocker locker(&pool()->mutex);
+    pool()->isEnabled = enabled;
+}
+
+bool QuillMetadataStringPool::isEnabled()
+{
+    QMutexLocker locker(&pool()->mutex);
+    return pool()->isEnabled;
+}
+
+QString QuillMetadataStringPool::intern(const QString &string)
+{
+    if (string.isEmpty())
+        return string;
+
+    QMutexLocker locker(&pool()->mutex);
+    if (!pool()->isEnabled)
+        return string;
+
+    // The copy in the set is implicitly shared with every caller
+    QSet<QString>::const_iterator i = pool()->strings.constFind(string);
+    if (i == pool()->strings.constEnd())
+        i = pool()->strings.insert(string);
+    return *i;
+}
+
+QStringList QuillMetadataStringPool::intern(const QStringList &strings)
+{
+    QStringList result;
+    foreach (const QString &string, strings)
+        result << intern(string);
+    return result;
+}
+
+int QuillMetadataStringPool::size()
+{
+    QMutexLocker locker(&pool()->mutex);
+    return pool()->strings.size();
+}
+
+void QuillMetadataStringPool::squeeze()
+{
+    QMutexLocker locker(&pool()->mutex);
+    QSet<QString>::iterator i = pool()->strings.begin();
+    while (i != pool()->strings.end()) {
+        // Only the pool refers to the data
+        if (i->isDetached())
+            i = pool()->strings.erase(i);
+        else
+            ++i;
+    }
+}
+
+void QuillMetadataStringPool::clear()
+{
+    QMutexLocker locker(&pool()->mutex);
+    pool()->strings.clear();
+}
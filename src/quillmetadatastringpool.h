@@ -0,0 +1,104 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#ifndef QUILLMETADATASTRINGPOOL_H
+#define QUILLMETADATASTRINGPOOL_H
+
+#include <QString>
+#include <QStringList>
+
+/*!
+  An optional process-wide pool of metadata strings.
+
+  Values such as camera make and model, places, creators and keywords
+  repeat across a collection of images. When the pool is enabled,
+  QuillMetadataSummary takes its strings from the pool, so that equal
+  values share one copy. Strings from the pool are equal exactly when
+  their constData() pointers are equal.
+
+  The pool is disabled by default, and all functions are thread-safe.
+ */
+
+class QuillMetadataStringPool
+{
+public:
+    /*!
+      Enables or disables the pool. Disabling it keeps the strings
+      already in the pool; use clear() to release them.
+     */
+    static void setEnabled(bool enabled);
+
+    /*!
+      Returns true if the pool is enabled.
+     */
+    static bool isEnabled();
+
+    /*!
+      Returns the pooled copy of a string, adding the string to the
+      pool if it is not there yet. If the pool is disabled, the string
+      is returned as it is.
+     */
+    static QString intern(const QString &string);
+
+    /*!
+      Returns a list of the pooled copies of the strings in a list.
+     */
+    static QStringList intern(const QStringList &strings);
+
+    /*!
+      Returns the number of strings in the pool.
+     */
+    static int size();
+
+    /*!
+      Removes the strings which are not referenced outside the pool.
+     */
+    static void squeeze();
+
+    /*!
+      Removes all strings from the pool. Strings still in use elsewhere
+      stay valid, but are no longer shared with new ones.
+     */
+    static void clear();
+
+private:
+    QuillMetadataStringPool();
+};
+
+#endif // QUILLMETADATASTRINGPOOL_H
@@ -0,0 +1,240 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#include "quillmetadatasummary.h"
+#include "quillmetadatastringpool.h"
+
+class QuillMetadataSummaryPrivate : public QSharedData
+{
+public:
+    QuillMetadataSummaryPrivate() :
+        timestamp(0), latitude(0), longitude(0), altitude(0),
+        tags(0), orientation(0), rating(0) {}
+
+    void read(const QuillMetadata &metadata);
+
+    void setTag(QuillMetadata::Tag tag) { tags |= (1u << tag); }
+
+    // Largest members first to keep the structure packed
+    qint64 timestamp;
+    double latitude;
+    double longitude;
+    double altitude;
+    QString make;
+    QString model;
+    QString creator;
+    QString city;
+    QString country;
+    QStringList keywords;
+    // One bit for each QuillMetadata::Tag with a value
+    quint32 tags;
+    qint8 orientation;
+    qint8 rating;
+};
+
+void QuillMetadataSummaryPrivate::read(const QuillMetadata &metadata)
+{
+    int intValue;
+    double doubleValue;
+    QString stringValue;
+    QDateTime dateTimeValue;
+
+    if (metadata.entry(QuillMetadata::Tag_Orientation, intValue) &&
+        (intValue >= 1) && (intValue <= 8)) {
+        orientation = intValue;
+        setTag(QuillMetadata::Tag_Orientation);
+    }
+
+    if (metadata.entry(QuillMetadata::Tag_TimestampOriginal, dateTimeValue)) {
+        timestamp = dateTimeValue.toMSecsSinceEpoch();
+        setTag(QuillMetadata::Tag_TimestampOriginal);
+    }
+    else if (metadata.entry(QuillMetadata::Tag_Timestamp, dateTimeValue)) {
+        timestamp = dateTimeValue.toMSecsSinceEpoch();
+        setTag(QuillMetadata::Tag_Timestamp);
+    }
+
+    if (metadata.entry(QuillMetadata::Tag_Rating, doubleValue)) {
+        rating = qBound(-1, qRound(doubleValue), 5);
+        setTag(QuillMetadata::Tag_Rating);
+    }
+
+    // The reference tags only give the signs
+    if (metadata.entry(QuillMetadata::Tag_GPSLatitude, doubleValue)) {
+        metadata.entry(QuillMetadata::Tag_GPSLatitudeRef, stringValue);
+        latitude = (stringValue == "S") ? -doubleValue : doubleValue;
+        setTag(QuillMetadata::Tag_GPSLatitude);
+    }
+    stringValue.clear();
+    if (metadata.entry(QuillMetadata::Tag_GPSLongitude, doubleValue)) {
+        metadata.entry(QuillMetadata::Tag_GPSLongitudeRef, stringValue);
+        longitude = (stringValue == "W") ? -doubleValue : doubleValue;
+        setTag(QuillMetadata::Tag_GPSLongitude);
+    }
+    if (metadata.entry(QuillMetadata::Tag_GPSAltitude, doubleValue)) {
+        intValue = 0;
+        metadata.entry(QuillMetadata::Tag_GPSAltitudeRef, intValue);
+        altitude = (intValue == 1) ? -doubleValue : doubleValue;
+        setTag(QuillMetadata::Tag_GPSAltitude);
+    }
+
+    if (metadata.entry(QuillMetadata::Tag_Make, make))
+        setTag(QuillMetadata::Tag_Make);
+    if (metadata.entry(QuillMetadata::Tag_Model, model))
+        setTag(QuillMetadata::Tag_Model);
+    if (metadata.entry(QuillMetadata::Tag_Creator, creator))
+        setTag(QuillMetadata::Tag_Creator);
+    if (metadata.entry(QuillMetadata::Tag_City, city))
+        setTag(QuillMetadata::Tag_City);
+    if (metadata.entry(QuillMetadata::Tag_Country, country))
+        setTag(QuillMetadata::Tag_Country);
+    if (metadata.entry(QuillMetadata::Tag_Subject, keywords))
+        setTag(QuillMetadata::Tag_Subject);
+
+    // Equal values of different images share their data, if enabled
+    make = QuillMetadataStringPool::intern(make);
+    model = QuillMetadataStringPool::intern(model);
+    creator = QuillMetadataStringPool::intern(creator);
+    city = QuillMetadataStringPool::intern(city);
+    country = QuillMetadataStringPool::intern(country);
+    keywords = QuillMetadataStringPool::intern(keywords);
+}
+
+QuillMetadataSummary::QuillMetadataSummary()
+{
+    d = new QuillMetadataSummaryPrivate;
+}
+
+QuillMetadataSummary::QuillMetadataSummary(const QString &fileName)
+{
+    d = new QuillMetadataSummaryPrivate;
+    // The parsed metadata only lives until the values are copied
+    d->read(QuillMetadata(fileName));
+}
+
+QuillMetadataSummary::QuillMetadataSummary(const QuillMetadata &metadata)
+{
+    d = new QuillMetadataSummaryPrivate;
+    d->read(metadata);
+}
+
+QuillMetadataSummary::QuillMetadataSummary(const QuillMetadataSummary &other)
+    :d(other.d)
+{
+}
+
+QuillMetadataSummary::~QuillMetadataSummary()
+{
+}
+
+QuillMetadataSummary &QuillMetadataSummary::operator=(const QuillMetadataSummary &other)
+{
+    d = other.d;
+    return *this;
+}
+
+bool QuillMetadataSummary::isValid() const
+{
+    return (d->tags != 0);
+}
+
+bool QuillMetadataSummary::hasEntry(QuillMetadata::Tag tag) const
+{
+    return (tag != QuillMetadata::Tag_Undefined) && (d->tags & (1u << tag));
+}
+
+int QuillMetadataSummary::orientation() const
+{
+    return d->orientation;
+}
+
+qint64 QuillMetadataSummary::timestamp() const
+{
+    return d->timestamp;
+}
+
+int QuillMetadataSummary::rating() const
+{
+    return d->rating;
+}
+
+double QuillMetadataSummary::latitude() const
+{
+    return d->latitude;
+}
+
+double QuillMetadataSummary::longitude() const
+{
+    return d->longitude;
+}
+
+double QuillMetadataSummary::altitude() const
+{
+    return d->altitude;
+}
+
+QString QuillMetadataSummary::make() const
+{
+    return d->make;
+}
+
+QString QuillMetadataSummary::model() const
+{
+    return d->model;
+}
+
+QString QuillMetadataSummary::creator() const
+{
+    return d->creator;
+}
+
+QString QuillMetadataSummary::city() const
+{
+    return d->city;
+}
+
+QString QuillMetadataSummary::country() const
+{
+    return d->country;
+}
+
+QStringList QuillMetadataSummary::keywords() const
+{
+    return d->keywords;
+}
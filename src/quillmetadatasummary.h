@@ -0,0 +1,150 @@
+/****************************************************************************
+**
+** Copyright (C) 2010-11 Nokia Corporation and/or its subsidiary(-ies).
+** Contact: Pekka Marjola <pekka.marjola@nokia.com>
+**
+** This file is part of the Quill Metadata package.
+**
+** Commercial Usage
+** Licensees holding valid Qt Commercial licenses may use this file in
+** accordance with the Qt Commercial License Agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Nokia.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Nokia gives you certain
+** additional rights. These rights are described in the Nokia Qt LGPL
+** Exception version 1.0, included in the file LGPL_EXCEPTION.txt in this
+** package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+** If you are unsure which license is appropriate for your use, please
+** contact the sales department at qt-sales@nokia.com.
+**
+****************************************************************************/
+
+#ifndef QUILLMETADATASUMMARY_H
+#define QUILLMETADATASUMMARY_H
+
+#include <QString>
+#include <QStringList>
+#include <QSharedDataPointer>
+
+#include "quillmetadata.h"
+
+class QuillMetadataSummaryPrivate;
+
+/*!
+  A compact, read-only copy of the metadata most often needed to list
+  and sort images: orientation, timestamp, location, rating and a few
+  descriptive strings.
+
+  The values are copied into a small packed structure and the parsed
+  EXIF and XMP data is released right away, so that a model can keep a
+  summary of every image in a large collection. Use QuillMetadata for
+  anything else, or for editing.
+
+  The strings are taken from QuillMetadataStringPool if it is enabled.
+ */
+
+class QuillMetadataSummary
+{
+public:
+    /*!
+      Constructs an empty summary.
+     */
+    QuillMetadataSummary();
+
+    /*!
+      Constructs a summary of the metadata of a given file.
+
+      @param fileName Local filesystem path to the file.
+     */
+    explicit QuillMetadataSummary(const QString &fileName);
+
+    /*!
+      Constructs a summary of a metadata object.
+     */
+    explicit QuillMetadataSummary(const QuillMetadata &metadata);
+
+    QuillMetadataSummary(const QuillMetadataSummary &other);
+    ~QuillMetadataSummary();
+
+    QuillMetadataSummary &operator=(const QuillMetadataSummary &other);
+
+    /*!
+      Returns true if any of the summarized entries was found.
+     */
+    bool isValid() const;
+
+    /*!
+      Returns true if the summary has a value for a given tag. The
+      GPS reference tags are folded into the signs of the coordinates
+      and altitude, and are not reported on their own.
+     */
+    bool hasEntry(QuillMetadata::Tag tag) const;
+
+    /*!
+      Returns the EXIF orientation, from 1 to 8, or 0 if unknown.
+     */
+    int orientation() const;
+
+    /*!
+      Returns the time the image was taken, or if unknown, the time its
+      metadata was last modified, in milliseconds since the epoch.
+      Returns 0 if neither is known.
+     */
+    qint64 timestamp() const;
+
+    /*!
+      Returns the rating of the image, or 0 if unknown.
+     */
+    int rating() const;
+
+    /*!
+      Returns the latitude in degrees, negative for the southern
+      hemisphere.
+     */
+    double latitude() const;
+
+    /*!
+      Returns the longitude in degrees, negative for the western
+      hemisphere.
+     */
+    double longitude() const;
+
+    /*!
+      Returns the altitude in meters, negative below sea level.
+     */
+    double altitude() const;
+
+    QString make() const;
+    QString model() const;
+    QString creator() const;
+    QString city() const;
+    QString country() const;
+
+    /*!
+      Returns the keywords of the image, see QuillMetadata::Tag_Subject.
+     */
+    QStringList keywords() const;
+
+private:
+    QSharedDataPointer<QuillMetadataSummaryPrivate> d;
+};
+
+#endif // QUILLMETADATASUMMARY_H
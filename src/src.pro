@@ -8,13 +8,23 @@ equals(QT_MAJOR_VERSION, 5): TARGET = quillmetadata-qt5
 
 MOC_DIR = .moc
 
-LIBS += -lexif -lexempi -ljpeg
+QT -= gui
+
+# The Qt-free parts live in the core library
+INCLUDEPATH += ../core
+QMAKE_LIBDIR += ../core
+equals(QT_MAJOR_VERSION, 4): LIBS += -lquillmetadata-core
+equals(QT_MAJOR_VERSION, 5): LIBS += -lquillmetadata-qt5-core
+
+# exempi is loaded on first use, see exempilibrary.cpp
+LIBS += -lexif
 # Generate pkg-config support by default
 # Note that we HAVE TO also create prl config as QMake implementation
 # mixes both of them together.
 CONFIG += create_pc create_prl no_install_prl
-equals(QT_MAJOR_VERSION, 4): QMAKE_PKGCONFIG_REQUIRES = QtGui
-equals(QT_MAJOR_VERSION, 5): QMAKE_PKGCONFIG_REQUIRES = Qt5Gui
+# The public API takes a ByteSource, whose header comes with the core library
+equals(QT_MAJOR_VERSION, 4): QMAKE_PKGCONFIG_REQUIRES = QtCore quillmetadata-core
+equals(QT_MAJOR_VERSION, 5): QMAKE_PKGCONFIG_REQUIRES = Qt5Core quillmetadata-qt5-core
 QMAKE_PKGCONFIG_INCDIR = $$[QT_INSTALL_HEADERS]/$$TARGET
 QMAKE_PKGCONFIG_LIBDIR = $$[QT_INSTALL_LIBS]
 
@@ -36,24 +46,38 @@ for(OPTION,$$list($$lower($$COV_OPTION))){
 HEADERS += quillmetadata.h \
            metadatarepresentation.h \
            xmp.h \
+           exempilibrary.h \
            exif.h \
-           exifwriteback.h \
+           iptc.h \
 	   quillmetadataregion.h \
-	   quillmetadataregionlist.h
+	   quillmetadataregionlist.h \
+           quillmetadataprobe.h \
+           quillmetadatasummary.h \
+           quillmetadatastringpool.h
 
 SOURCES += quillmetadata.cpp \
            xmp.cpp \
+           exempilibrary.cpp \
            exif.cpp \
-           exifwriteback.cpp \
+           iptc.cpp \
 	   quillmetadataregion.cpp \
-	   quillmetadataregionlist.cpp
+	   quillmetadataregionlist.cpp \
+           quillmetadataprobe.cpp \
+           quillmetadatasummary.cpp \
+           quillmetadatastringpool.cpp
 
 INSTALL_HEADERS = QuillMetadata \
                   quillmetadata.h \
                   QuillMetadataRegion \
 		  quillmetadataregion.h \
                   QuillMetadataRegionList \
-		  quillmetadataregionlist.h
+		  quillmetadataregionlist.h \
+                  QuillMetadataProbe \
+                  quillmetadataprobe.h \
+                  QuillMetadataSummary \
+                  quillmetadatasummary.h \
+                  QuillMetadataStringPool \
+                  quillmetadatastringpool.h
 
 # --- install
 headers.files = $$INSTALL_HEADERS
@@ -40,15 +40,31 @@
 #include <QStringList>
 #include <QLocale>
 #include <QTextStream>
-#include <exempi-2.0/exempi/xmpconsts.h>
+#include <QSet>
+#include <string.h>
 #include <math.h>
 #include "xmp.h"
+#include "exempilibrary.h"
+#include "jpegheader.h"
+#include "segmentwriteback.h"
 #include "quillmetadataregionlist.h"
 
 QHash<QuillMetadata::Tag,XmpTag> Xmp::m_xmpTags;
 QHash<Xmp::Tag,XmpRegionTag> Xmp::m_regionXmpTags;
 
-bool Xmp::m_initialized = false;
+
+// The namespaces of xmpconsts.h, which are data in the exempi library
+static const char NS_DC[] = "http://purl.org/dc/elements/1.1/";
+static const char NS_PHOTOSHOP[] = "http://ns.adobe.com/photoshop/1.0/";
+static const char NS_IPTC4XMP[] = "http://iptc.org/std/Iptc4xmpCore/1.0/xmlns/";
+static const char NS_XAP[] = "http://ns.adobe.com/xap/1.0/";
+static const char NS_EXIF[] = "http://ns.adobe.com/exif/1.0/";
+static const char NS_TIFF[] = "http://ns.adobe.com/tiff/1.0/";
+
+static inline const ExempiLibrary *exempi()
+{
+    return ExempiLibrary::instance();
+}
 
 XmpTag::XmpTag(const QString &schema, const QString &tag, TagType tagType) :
     schema(schema), tag(tag), tagType(tagType)
@@ -80,46 +96,60 @@ QString XmpRegionTag::getIndexedTag(int zeroBasedIndex)
     return baseTag + QString("%1").arg(zeroBasedIndex+1) + tag;
 }
 
-Xmp::Xmp()
+Xmp::Xmp() : m_xmpPtr(0), m_dumpValid(false), m_isEmpty(true)
 {
-    xmp_init();
-    m_xmpPtr = xmp_new_empty();
-    initTags();
+    // Nothing is loaded until the packet is read or modified
 }
 
-Xmp::Xmp(const QString &fileName)
+Xmp::Xmp(const QString &fileName) :
+    m_xmpPtr(0), m_dumpValid(false), m_isEmpty(false)
 {
-    xmp_init();
-    XmpFilePtr xmpFilePtr = xmp_files_open_new(fileName.toLocal8Bit().constData(),
+    if (!exempi())
+        return;
+
+    XmpFilePtr xmpFilePtr = exempi()->xmp_files_open_new(fileName.toLocal8Bit().constData(),
                                                XMP_OPEN_READ);
-    m_xmpPtr = xmp_files_get_new_xmp(xmpFilePtr);
-    xmp_files_close(xmpFilePtr, XMP_CLOSE_NOOPTION);
-    xmp_files_free(xmpFilePtr);
+    m_xmpPtr = exempi()->xmp_files_get_new_xmp(xmpFilePtr);
+    exempi()->xmp_files_close(xmpFilePtr, XMP_CLOSE_NOOPTION);
+    exempi()->xmp_files_free(xmpFilePtr);
 
     initTags();
 }
 
+Xmp::Xmp(const QByteArray &packet) :
+    m_xmpPtr(0), m_dumpValid(false), m_isEmpty(false)
+{
+    // Like a file without XMP, an empty packet gives an invalid object
+    if (!packet.isEmpty())
+        load(packet);
+}
+
 Xmp::~Xmp()
 {
-    xmp_free(m_xmpPtr);
+    if (m_xmpPtr)
+        exempi()->xmp_free(m_xmpPtr);
 }
 
 bool Xmp::isValid() const
 {
-    return (m_xmpPtr != 0);
+    return (m_xmpPtr != 0) || m_isEmpty;
 }
 
 bool Xmp::supportsEntry(QuillMetadata::Tag tag) const
 {
+    initTags();
     return m_xmpTags.contains(tag);
 }
 
 bool Xmp::hasEntry(QuillMetadata::Tag tag) const
 {
+    if (!m_xmpPtr)
+        return false;
+
     QList<XmpTag> xmpTags = m_xmpTags.values(tag);
     if (!xmpTags.isEmpty()) {
     foreach (XmpTag tag, xmpTags) {
-        if (xmp_has_property(m_xmpPtr,
+        if (exempi()->xmp_has_property(m_xmpPtr,
                  tag.schema.toLatin1().constData(),
                  tag.tag.toLatin1().constData()))
         return true;
@@ -131,17 +161,17 @@ bool Xmp::hasEntry(QuillMetadata::Tag tag) const
 bool Xmp::hasEntry(Xmp::Tag tag, int zeroBasedIndex) const
 {
     XmpRegionTag xmpTag = m_regionXmpTags.value(tag);
-    if (xmpTag.tag.isEmpty())
+    if (xmpTag.tag.isEmpty() || !m_xmpPtr)
     return false;
 
-    return (xmp_has_property(m_xmpPtr,
+    return (exempi()->xmp_has_property(m_xmpPtr,
                  xmpTag.schema.toLatin1().constData(),
                  xmpTag.getIndexedTag(zeroBasedIndex).toLatin1().constData()));
 }
 
 QString Xmp::processXmpString(XmpStringPtr xmpString)
 {
-    return QString(xmp_string_cstr(xmpString)).trimmed();
+    return QString(exempi()->xmp_string_cstr(xmpString)).trimmed();
 }
 
 void Xmp::readRegionListItem(const QString & qPropValue,
@@ -223,17 +253,18 @@ void Xmp::readRegionListItem(const QString & qPropValue,
 
 QVariant Xmp::entry(QuillMetadata::Tag tag) const
 {
-    if (!supportsEntry(tag))
+    // Without a packet there is nothing to read, and no need for exempi
+    if (!m_xmpPtr || !supportsEntry(tag))
         return QVariant();
 
     QList<XmpTag> xmpTags = m_xmpTags.values(tag);
 
-    XmpStringPtr xmpStringPtr = xmp_string_new();
+    XmpStringPtr xmpStringPtr = exempi()->xmp_string_new();
 
     foreach (XmpTag xmpTag, xmpTags) {
         uint32_t propBits;
 
-    if (xmp_get_property(m_xmpPtr,
+    if (exempi()->xmp_get_property(m_xmpPtr,
                  xmpTag.schema.toLatin1().constData(),
                              xmpTag.tag.toLatin1().constData(),
                              xmpStringPtr,
@@ -242,7 +273,7 @@ QVariant Xmp::entry(QuillMetadata::Tag tag) const
             if (XMP_IS_PROP_ARRAY(propBits)) {
         QStringList list;
                 int i = 1;
-                while (xmp_get_array_item(m_xmpPtr,
+                while (exempi()->xmp_get_array_item(m_xmpPtr,
                                           xmpTag.schema.toLatin1().constData(),
                                           xmpTag.tag.toLatin1().constData(),
                                           i,
@@ -255,7 +286,7 @@ QVariant Xmp::entry(QuillMetadata::Tag tag) const
                 }
 
                 if (!list.isEmpty()) {
-                    xmp_string_free(xmpStringPtr);
+                    exempi()->xmp_string_free(xmpStringPtr);
                     return QVariant(list);
                 }
 
@@ -264,19 +295,19 @@ QVariant Xmp::entry(QuillMetadata::Tag tag) const
 
         XmpIterOptions iterOpts = XMP_ITER_OMITQUALIFIERS;
 
-        XmpIteratorPtr xmpIterPtr = xmp_iterator_new(
+        XmpIteratorPtr xmpIterPtr = exempi()->xmp_iterator_new(
             m_xmpPtr, xmpTag.schema.toLatin1().constData(),
             xmpTag.tag.toLatin1().constData(),
             iterOpts);
 
-        XmpStringPtr schema = xmp_string_new();
-        XmpStringPtr propName = xmp_string_new();
-        XmpStringPtr propValue = xmp_string_new();
+        XmpStringPtr schema = exempi()->xmp_string_new();
+        XmpStringPtr propName = exempi()->xmp_string_new();
+        XmpStringPtr propValue = exempi()->xmp_string_new();
 
         uint32_t options;
         QuillMetadataRegionList regions;
 
-        bool bSuccess = xmp_iterator_next(
+        bool bSuccess = exempi()->xmp_iterator_next(
             xmpIterPtr, schema, propName,
             propValue, &options);
 
@@ -303,14 +334,14 @@ QVariant Xmp::entry(QuillMetadata::Tag tag) const
 
             }
 
-            bSuccess = xmp_iterator_next(
+            bSuccess = exempi()->xmp_iterator_next(
                 xmpIterPtr, schema, propName,
                 propValue, &options);
         } // while (bSuccess)
 
-        xmp_string_free(schema);
-        xmp_string_free(propName);
-        xmp_string_free(propValue);
+        exempi()->xmp_string_free(schema);
+        exempi()->xmp_string_free(propName);
+        exempi()->xmp_string_free(propValue);
 
         QVariant var;
         regions.updatePixelCoordinates();
@@ -321,68 +352,303 @@ QVariant Xmp::entry(QuillMetadata::Tag tag) const
         } else {
                 QString string = processXmpString(xmpStringPtr);
                 if (!string.isEmpty()) {
-                    xmp_string_free(xmpStringPtr);
-                    switch (tag) {
-            case QuillMetadata::Tag_GPSLatitude:
-            case QuillMetadata::Tag_GPSLongitude: {
-                            // Degrees and minutes are separated with a ','
-                            QStringList elements = string.split(",");
-                            QLocale c(QLocale::C);
-                            double value = 0, term = 0;
-                            for (int i = 0, power = 1; i < elements.length(); i ++, power *= 60) {
-                                term = c.toDouble(elements[i]);
-                                if (i == elements.length() - 1) {
-                                    term = c.toDouble(elements[i].mid(0, elements[i].length() - 2));
-                                }
-                                value += term / power;
-                            }
-
-                            return QVariant(value);
-                        }
-
-            case QuillMetadata::Tag_GPSLatitudeRef:
-            case QuillMetadata::Tag_GPSLongitudeRef: {
-                            // The 'W', 'E', 'N' or 'S' character is the rightmost character
-                            // in the field
-                            return QVariant(string.right(1));
-                        }
-
-            case QuillMetadata::Tag_GPSImgDirection:
-            case QuillMetadata::Tag_GPSAltitude: {
-                            const int separator = string.indexOf("/");
-                            const int len = string.length();
-                            QLocale c(QLocale::C);
-
-                            double numerator = c.toDouble(string.mid(0, separator));
-                            double denominator = c.toDouble(string.mid(separator + 1, len - separator - 1));
-
-                            if (denominator && separator != -1) {
-                                return QVariant(numerator / denominator);
-                            }
-                            else {
-                                return QVariant(numerator);
-                            }
-                        }
-
-            default:
-            return QVariant(string);
-            }
+                    exempi()->xmp_string_free(xmpStringPtr);
+                    return stringValue(tag, string);
                 }
             }
     }
     }
 
-    xmp_string_free(xmpStringPtr);
+    exempi()->xmp_string_free(xmpStringPtr);
     return QVariant();
 }
 
+double Xmp::parseCoordinate(const QString &string)
+{
+    // Degrees and minutes are separated with a ','
+    QStringList elements = string.split(",");
+    QLocale c(QLocale::C);
+    double value = 0, term = 0;
+    for (int i = 0, power = 1; i < elements.length(); i ++, power *= 60) {
+        term = c.toDouble(elements[i]);
+        if (i == elements.length() - 1) {
+            term = c.toDouble(elements[i].mid(0, elements[i].length() - 2));
+        }
+        value += term / power;
+    }
+
+    return value;
+}
+
+double Xmp::parseRational(const QString &string)
+{
+    const int separator = string.indexOf("/");
+    const int len = string.length();
+    QLocale c(QLocale::C);
+
+    double numerator = c.toDouble(string.mid(0, separator));
+    double denominator = c.toDouble(string.mid(separator + 1, len - separator - 1));
+
+    if (denominator && separator != -1)
+        return numerator / denominator;
+    else
+        return numerator;
+}
+
+QVariant Xmp::stringValue(QuillMetadata::Tag tag, const QString &string)
+{
+    switch (tag) {
+    case QuillMetadata::Tag_GPSLatitude:
+    case QuillMetadata::Tag_GPSLongitude:
+        return QVariant(parseCoordinate(string));
+
+    case QuillMetadata::Tag_GPSLatitudeRef:
+    case QuillMetadata::Tag_GPSLongitudeRef:
+        // The 'W', 'E', 'N' or 'S' character is the rightmost character
+        // in the field
+        return QVariant(string.right(1));
+
+    case QuillMetadata::Tag_GPSImgDirection:
+    case QuillMetadata::Tag_GPSAltitude:
+        return QVariant(parseRational(string));
+
+    default:
+        return QVariant(string);
+    }
+}
+
+/*!
+  Strips the namespace prefix from a property path, "dc:subject[2]"
+  becomes "subject[2]".
+ */
+
+static QByteArray localName(const char *path)
+{
+    const char *colon = strchr(path, ':');
+    return QByteArray(colon ? colon + 1 : path);
+}
+
+void Xmp::entries(const QList<QuillMetadata::Tag> &tags,
+                  QMap<QuillMetadata::Tag, QVariant> &result) const
+{
+    if (!m_xmpPtr)
+        return;
+
+    // Properties of interest, keyed by schema and local name. Struct
+    // valued tags (regions) have their own parser and are read apart.
+    QHash<QByteArray, QStringList> properties;
+    QSet<QByteArray> arrays;
+    QList<QuillMetadata::Tag> structTags;
+    foreach (QuillMetadata::Tag tag, tags) {
+        foreach (XmpTag xmpTag, m_xmpTags.values(tag)) {
+            if (xmpTag.tagType == XmpTag::TagTypeStruct) {
+                structTags << tag;
+                break;
+            }
+            properties.insert(xmpTag.schema.toLatin1() + ' ' +
+                              localName(xmpTag.tag.toLatin1().constData()),
+                              QStringList());
+        }
+    }
+
+    if (!properties.isEmpty()) {
+        XmpIteratorPtr xmpIterPtr = exempi()->xmp_iterator_new(m_xmpPtr, "", "",
+                                                     XMP_ITER_OMITQUALIFIERS);
+        XmpStringPtr schema = exempi()->xmp_string_new();
+        XmpStringPtr propName = exempi()->xmp_string_new();
+        XmpStringPtr propValue = exempi()->xmp_string_new();
+        uint32_t options;
+
+        while (exempi()->xmp_iterator_next(xmpIterPtr, schema, propName,
+                                 propValue, &options)) {
+            const char *path = exempi()->xmp_string_cstr(propName);
+            // Only top level properties and the items of top level arrays
+            if (!*path || strchr(path, '/'))
+                continue;
+
+            QByteArray name = localName(path);
+            int bracket = name.indexOf('[');
+            if (bracket != -1)
+                name.truncate(bracket);
+
+            QByteArray key = QByteArray(exempi()->xmp_string_cstr(schema)) + ' ' + name;
+            QHash<QByteArray, QStringList>::iterator property =
+                properties.find(key);
+            if (property == properties.end())
+                continue;
+
+            if (bracket != -1)
+                arrays.insert(key);
+
+            QString string = processXmpString(propValue);
+            if (!string.isEmpty())
+                property.value() << string;
+        }
+
+        exempi()->xmp_string_free(schema);
+        exempi()->xmp_string_free(propName);
+        exempi()->xmp_string_free(propValue);
+        exempi()->xmp_iterator_free(xmpIterPtr);
+    }
+
+    // Resolve the values with the same priority as entry() does
+    foreach (QuillMetadata::Tag tag, tags) {
+        if (structTags.contains(tag)) {
+            QVariant value = entry(tag);
+            if (!value.isNull())
+                result.insert(tag, value);
+            continue;
+        }
+
+        foreach (XmpTag xmpTag, m_xmpTags.values(tag)) {
+            const QByteArray key = xmpTag.schema.toLatin1() + ' ' +
+                localName(xmpTag.tag.toLatin1().constData());
+            const QStringList values = properties.value(key);
+            if (values.isEmpty())
+                continue;
+
+            if (arrays.contains(key))
+                result.insert(tag, QVariant(values));
+            else
+                result.insert(tag, stringValue(tag, values.first()));
+            break;
+        }
+    }
+}
+
+bool Xmp::propertyValues(QuillMetadata::Tag tag, QStringList &values) const
+{
+    if (!m_xmpPtr || !supportsEntry(tag))
+        return false;
+
+    QList<XmpTag> xmpTags = m_xmpTags.values(tag);
+
+    XmpStringPtr xmpStringPtr = exempi()->xmp_string_new();
+
+    foreach (XmpTag xmpTag, xmpTags) {
+        uint32_t propBits;
+        const QByteArray schema = xmpTag.schema.toLatin1();
+        const QByteArray name = xmpTag.tag.toLatin1();
+
+        if (!exempi()->xmp_get_property(m_xmpPtr, schema.constData(), name.constData(),
+                              xmpStringPtr, &propBits) ||
+            XMP_IS_PROP_STRUCT(propBits))
+            continue;
+
+        if (XMP_IS_PROP_ARRAY(propBits)) {
+            int i = 1;
+            while (exempi()->xmp_get_array_item(m_xmpPtr, schema.constData(),
+                                      name.constData(), i,
+                                      xmpStringPtr, &propBits)) {
+                QString string = processXmpString(xmpStringPtr);
+                if (!string.isEmpty())
+                    values << string;
+                i++;
+            }
+        } else {
+            QString string = processXmpString(xmpStringPtr);
+            if (!string.isEmpty())
+                values << string;
+        }
+
+        if (!values.isEmpty())
+            break;
+    }
+
+    exempi()->xmp_string_free(xmpStringPtr);
+    return !values.isEmpty();
+}
+
+bool Xmp::entry(QuillMetadata::Tag tag, QStringList &value) const
+{
+    QStringList values;
+    if (!propertyValues(tag, values))
+        return false;
+
+    value = values;
+    return true;
+}
+
+bool Xmp::entry(QuillMetadata::Tag tag, QString &value) const
+{
+    QStringList values;
+    if (!propertyValues(tag, values))
+        return false;
+
+    switch (tag) {
+    case QuillMetadata::Tag_GPSLatitudeRef:
+    case QuillMetadata::Tag_GPSLongitudeRef:
+        // The reference is the rightmost character of the coordinate
+        value = values.first().right(1);
+        break;
+    default:
+        value = values.first();
+        break;
+    }
+    return true;
+}
+
+bool Xmp::entry(QuillMetadata::Tag tag, double &value) const
+{
+    QStringList values;
+    if (!propertyValues(tag, values))
+        return false;
+
+    switch (tag) {
+    case QuillMetadata::Tag_GPSLatitude:
+    case QuillMetadata::Tag_GPSLongitude:
+        value = parseCoordinate(values.first());
+        return true;
+    case QuillMetadata::Tag_GPSImgDirection:
+    case QuillMetadata::Tag_GPSAltitude:
+        value = parseRational(values.first());
+        return true;
+    default: {
+        bool isOk = false;
+        double result = QLocale(QLocale::C).toDouble(values.first(), &isOk);
+        if (isOk)
+            value = result;
+        return isOk;
+    }
+    }
+}
+
+bool Xmp::entry(QuillMetadata::Tag tag, int &value) const
+{
+    double result;
+    if (!entry(tag, result))
+        return false;
+
+    value = (int)result;
+    return true;
+}
+
+bool Xmp::entry(QuillMetadata::Tag tag, QDateTime &value) const
+{
+    QStringList values;
+    if (!propertyValues(tag, values))
+        return false;
+
+    QDateTime result = QDateTime::fromString(values.first(), Qt::ISODate);
+    if (!result.isValid())
+        return false;
+
+    value = result;
+    return true;
+}
+
 void Xmp::setEntry(QuillMetadata::Tag tag, const QVariant &entry)
 {
     if (!supportsEntry(tag))
         return;
 
+    m_dumpValid = false;
+
     if (!m_xmpPtr) {
-        m_xmpPtr = xmp_new_empty();
+        if (!exempi())
+            return;
+        m_xmpPtr = exempi()->xmp_new_empty();
+        m_isEmpty = false;
     }
 
     switch (tag) {
@@ -588,24 +854,24 @@ void Xmp::setXmpEntry(Xmp::Tag tag, int zeroBasedIndex,
 
 void Xmp::setXmpEntry(XmpTag xmpTag, const QVariant &entry)
 {
-    xmp_delete_property(m_xmpPtr,
+    exempi()->xmp_delete_property(m_xmpPtr,
             xmpTag.schema.toLatin1().constData(),
             xmpTag.tag.toLatin1().constData());
 
     if (xmpTag.tagType == XmpTag::TagTypeString){
-    xmp_set_property(m_xmpPtr,
+    exempi()->xmp_set_property(m_xmpPtr,
              xmpTag.schema.toLatin1().constData(),
              xmpTag.tag.toLatin1().constData(),
              entry.toString().toUtf8().constData(), 0);
     }
     else if (xmpTag.tagType == XmpTag::TagTypeStruct){
-    xmp_set_property(m_xmpPtr,
+    exempi()->xmp_set_property(m_xmpPtr,
              xmpTag.schema.toLatin1().constData(),
              xmpTag.tag.toLatin1().constData(),
              entry.toString().toUtf8().constData(), XMP_PROP_VALUE_IS_STRUCT);
     }
     else if (xmpTag.tagType == XmpTag::TagTypeArray){
-    xmp_set_property(m_xmpPtr,
+    exempi()->xmp_set_property(m_xmpPtr,
              xmpTag.schema.toLatin1().constData(),
              xmpTag.tag.toLatin1().constData(),
              entry.toString().toUtf8().constData(), XMP_PROP_VALUE_IS_ARRAY);
@@ -613,27 +879,27 @@ void Xmp::setXmpEntry(XmpTag xmpTag, const QVariant &entry)
     else if (xmpTag.tagType == XmpTag::TagTypeStringList) {
     QStringList list = entry.toStringList();
     foreach (QString string, list)
-        xmp_append_array_item(m_xmpPtr,
+        exempi()->xmp_append_array_item(m_xmpPtr,
                   xmpTag.schema.toLatin1().constData(),
                   xmpTag.tag.toLatin1().constData(),
                   XMP_PROP_ARRAY_IS_UNORDERED,
                   string.toUtf8().constData(), 0);
     }
     else if (xmpTag.tagType == XmpTag::TagTypeAltLang) {
-    xmp_set_localized_text(m_xmpPtr,
+    exempi()->xmp_set_localized_text(m_xmpPtr,
                    xmpTag.schema.toLatin1().constData(),
                    xmpTag.tag.toLatin1().constData(),
                    "", "x-default",
                    entry.toString().toUtf8().constData(), 0);
     }
     else if (xmpTag.tagType == XmpTag::TagTypeReal) {
-    xmp_set_property_float(m_xmpPtr,
+    exempi()->xmp_set_property_float(m_xmpPtr,
                    xmpTag.schema.toLatin1().constData(),
                    xmpTag.tag.toLatin1().constData(),
                    entry.toReal(), 0);
     }
     else if (xmpTag.tagType == XmpTag::TagTypeInteger) {
-    xmp_set_property_int32(m_xmpPtr,
+    exempi()->xmp_set_property_int32(m_xmpPtr,
                    xmpTag.schema.toLatin1().constData(),
                    xmpTag.tag.toLatin1().constData(),
                    entry.toInt(), 0);
@@ -642,16 +908,15 @@ void Xmp::setXmpEntry(XmpTag xmpTag, const QVariant &entry)
 
 void Xmp::removeEntry(QuillMetadata::Tag tag)
 {
-    if (!supportsEntry(tag))
+    if (!m_xmpPtr || !supportsEntry(tag))
     return;
 
-    if (!m_xmpPtr)
-    return;
+    m_dumpValid = false;
 
     QList<XmpTag> xmpTags = m_xmpTags.values(tag);
 
     foreach (XmpTag xmpTag, xmpTags) {
-    xmp_delete_property(m_xmpPtr,
+    exempi()->xmp_delete_property(m_xmpPtr,
                 xmpTag.schema.toLatin1().constData(),
                 xmpTag.tag.toLatin1().constData());
     }
@@ -660,82 +925,147 @@ void Xmp::removeEntry(QuillMetadata::Tag tag)
 void Xmp::removeEntry(Xmp::Tag tag, int zeroBasedIndex)
 {
     XmpRegionTag xmpTag = m_regionXmpTags.value(tag);
-    if (xmpTag.tag.isEmpty())
+    if (xmpTag.tag.isEmpty() || !m_xmpPtr)
     return;
 
-    xmp_delete_property(m_xmpPtr,
+    exempi()->xmp_delete_property(m_xmpPtr,
                  xmpTag.schema.toLatin1().constData(),
                  xmpTag.getIndexedTag(zeroBasedIndex).toLatin1().constData());
 }
 
 bool Xmp::write(const QString &fileName) const
 {
+    if (!exempi())
+        return false;
+
     XmpPtr ptr = m_xmpPtr;
 
     if (!ptr)
-    ptr = xmp_new_empty();
+    ptr = exempi()->xmp_new_empty();
 
-    XmpFilePtr xmpFilePtr = xmp_files_open_new(fileName.toLocal8Bit().constData(),
+    XmpFilePtr xmpFilePtr = exempi()->xmp_files_open_new(fileName.toLocal8Bit().constData(),
                                                XMP_OPEN_FORUPDATE);
     bool result;
 
-    if (xmp_files_can_put_xmp(xmpFilePtr, ptr))
-    result = xmp_files_put_xmp(xmpFilePtr, ptr);
+    if (exempi()->xmp_files_can_put_xmp(xmpFilePtr, ptr))
+    result = exempi()->xmp_files_put_xmp(xmpFilePtr, ptr);
     else
     result = false;
 
     // Crash safety can be ignored here by selecting Nooption since
     // QuillFile already has crash safety measures.
     if (result)
-    result = xmp_files_close(xmpFilePtr, XMP_CLOSE_NOOPTION);
-    xmp_files_free(xmpFilePtr);
+    result = exempi()->xmp_files_close(xmpFilePtr, XMP_CLOSE_NOOPTION);
+    exempi()->xmp_files_free(xmpFilePtr);
 
     if (!m_xmpPtr)
-    xmp_free(ptr);
+    exempi()->xmp_free(ptr);
 
     return result;
 }
 
-void Xmp::initTags()
+// The padding which exempi leaves in packets it writes to files
+static const int PacketPadding = 2048;
+
+bool Xmp::write(int fd) const
 {
-    if (m_initialized)
-    return;
+    // exempi only writes files by name, so the APP1 segment is replaced
+    // directly; without a packet, the segment is removed
+    QByteArray packet;
+    if (m_xmpPtr) {
+        // Unlike dump(), a packet in a file is wrapped and padded, so
+        // that editors can update it in place
+        XmpStringPtr xmpStringPtr = exempi()->xmp_string_new();
+        if (!exempi()->xmp_serialize(m_xmpPtr, xmpStringPtr, 0, PacketPadding)) {
+            exempi()->xmp_string_free(xmpStringPtr);
+            return false;
+        }
+        packet = QByteArray(exempi()->xmp_string_cstr(xmpStringPtr));
+        exempi()->xmp_string_free(xmpStringPtr);
+    }
 
-    m_initialized = true;
+    const std::string signature("http://ns.adobe.com/xap/1.0/\0", 29);
+    return SegmentWriteback::writeback(fd, JpegHeader::Marker_APP1, signature,
+                                       packet.isEmpty() ? std::string() :
+                                       signature + std::string(packet.constData(),
+                                                               packet.size()));
+}
 
-    const char regionSchema[] = "http://www.metadataworkinggroup.com/schemas/regions/";
-    QString regionPrefix("mwg-rs:");
-    {
+bool Xmp::load(const QByteArray &data)
+{
+    if (!exempi())
+        return false;
 
-    XmpStringPtr registeredPrefix = xmp_string_new();
-    xmp_register_namespace(regionSchema,
-                     regionPrefix.toLatin1().constData(),
-                     registeredPrefix);
-    regionPrefix = processXmpString(registeredPrefix);
-    xmp_string_free(registeredPrefix);
-    }
+    initTags();
 
-    QString xmpAreaPrefix("stArea:");
-    {
-    const char areaNamespace[] = "http://ns.adobe.com/xmp/sType/Area#";
-    XmpStringPtr registeredPrefix = xmp_string_new();
-    xmp_register_namespace(areaNamespace,
-                      xmpAreaPrefix.toLatin1().constData(),
-                      registeredPrefix);
-    xmpAreaPrefix = processXmpString(registeredPrefix);
-    xmp_string_free(registeredPrefix);
-    }
+    XmpPtr xmpPtr = exempi()->xmp_new(data.constData(), data.size());
+    if (!xmpPtr)
+        return false;
 
-    QString ncoPrefix("nco:");
-    {
-    const char ncoNamespace[] = "http://www.semanticdesktop.org/ontologies/2007/03/22/nco#";
-    XmpStringPtr registeredPrefix = xmp_string_new();
-    xmp_register_namespace(ncoNamespace,
-                      ncoPrefix.toLatin1().constData(),
-                      registeredPrefix);
-    ncoPrefix = processXmpString(registeredPrefix);
-    xmp_string_free(registeredPrefix);
-    }
+    if (m_xmpPtr)
+        exempi()->xmp_free(m_xmpPtr);
+    m_xmpPtr = xmpPtr;
+    m_dumpValid = false;
+    m_isEmpty = false;
+
+    return true;
+}
+
+QByteArray Xmp::dump() const
+{
+    if (!m_xmpPtr)
+        return QByteArray();
+
+    // The packet is shared with all callers until it is modified
+    if (m_dumpValid)
+        return m_dump;
+
+    XmpStringPtr xmpStringPtr = exempi()->xmp_string_new();
+    if (exempi()->xmp_serialize(m_xmpPtr, xmpStringPtr, XMP_SERIAL_OMITPACKETWRAPPER, 0))
+        m_dump = QByteArray(exempi()->xmp_string_cstr(xmpStringPtr));
+    else
+        m_dump = QByteArray();
+    m_dumpValid = true;
+    exempi()->xmp_string_free(xmpStringPtr);
+
+    return m_dump;
+}
+
+QString Xmp::registerNamespace(const char *namespaceUri,
+                               const QString &suggestedPrefix)
+{
+    // Without exempi there is no packet using the prefix either
+    if (!exempi())
+        return suggestedPrefix;
+
+    XmpStringPtr registeredPrefix = exempi()->xmp_string_new();
+    exempi()->xmp_register_namespace(namespaceUri,
+                                     suggestedPrefix.toLatin1().constData(),
+                                     registeredPrefix);
+    QString prefix = processXmpString(registeredPrefix);
+    exempi()->xmp_string_free(registeredPrefix);
+
+    return prefix;
+}
+
+void Xmp::initTags()
+{
+    // Called on every lookup, so only the first call may lock
+    static const bool isFilled = fillTags();
+    Q_UNUSED(isFilled);
+}
+
+bool Xmp::fillTags()
+{
+    // Namespaces are registered only once XMP is actually used
+    const char regionSchema[] = "http://www.metadataworkinggroup.com/schemas/regions/";
+    QString regionPrefix =
+        registerNamespace(regionSchema, "mwg-rs:");
+    QString xmpAreaPrefix =
+        registerNamespace("http://ns.adobe.com/xmp/sType/Area#", "stArea:");
+    QString ncoPrefix =
+        registerNamespace("http://www.semanticdesktop.org/ontologies/2007/03/22/nco#",
+                          "nco:");
 
     m_xmpTags.insertMulti(QuillMetadata::Tag_Creator,
               XmpTag(NS_DC, "creator", XmpTag::TagTypeString));
@@ -864,4 +1194,5 @@ void Xmp::initTags()
                XmpRegionTag(regionSchema, baseTag, xmpAreaPrefix + "y",
                     XmpTag::TagTypeReal));
 
+    return true;
 }
@@ -42,6 +42,7 @@
 
 #include <exempi-2.0/exempi/xmp.h>
 #include <QHash>
+#include <QMap>
 
 #include "metadatarepresentation.h"
 
@@ -82,16 +83,27 @@ class Xmp : public MetadataRepresentation
 
     Xmp();
     Xmp(const QString &fileName);
+    Xmp(const QByteArray &packet);
     ~Xmp();
 
     bool isValid() const;
 
     bool supportsEntry(QuillMetadata::Tag tag) const;
     QVariant entry(QuillMetadata::Tag tag) const;
+    bool entry(QuillMetadata::Tag tag, int &value) const;
+    bool entry(QuillMetadata::Tag tag, double &value) const;
+    bool entry(QuillMetadata::Tag tag, QString &value) const;
+    bool entry(QuillMetadata::Tag tag, QStringList &value) const;
+    bool entry(QuillMetadata::Tag tag, QDateTime &value) const;
+    void entries(const QList<QuillMetadata::Tag> &tags,
+                 QMap<QuillMetadata::Tag, QVariant> &result) const;
     void setEntry(QuillMetadata::Tag tag, const QVariant &entry);
     void removeEntry(QuillMetadata::Tag tag);
 
+    bool load(const QByteArray &data);
     bool write(const QString &fileName) const;
+    bool write(int fd) const;
+    QByteArray dump() const;
 
  private:
 
@@ -127,10 +139,22 @@ class Xmp : public MetadataRepresentation
        Tag_RegionExtensionTrackerContact,
 
    };
-    void initTags();
+    static void initTags();
+    static bool fillTags();
+
+    static QString registerNamespace(const char *namespaceUri,
+                                     const QString &suggestedPrefix);
 
     static QString processXmpString(XmpStringPtr xmpString);
 
+    static double parseCoordinate(const QString &string);
+
+    static double parseRational(const QString &string);
+
+    static QVariant stringValue(QuillMetadata::Tag tag, const QString &string);
+
+    bool propertyValues(QuillMetadata::Tag tag, QStringList &values) const;
+
     void setXmpEntry(QuillMetadata::Tag tag, const QVariant &entry);
 
     void setXmpEntry(Xmp::Tag tag, int zeroBasedIndex,
@@ -155,7 +179,13 @@ class Xmp : public MetadataRepresentation
 
     XmpPtr m_xmpPtr;
 
-    static bool m_initialized;
+    // Serialized packet, kept until the next modification
+    mutable QByteArray m_dump;
+    mutable bool m_dumpValid;
+
+    // An empty packet, only created in exempi once it is modified
+    bool m_isEmpty;
+
 };
 
 #endif
@@ -2,8 +2,8 @@
 
 TEMPLATE = app
 DEPENDPATH += .
-INCLUDEPATH += . ../../src
-QMAKE_LIBDIR += ../../src ../bin
+INCLUDEPATH += . ../../src ../../core
+QMAKE_LIBDIR += ../../src ../../core ../bin
 QMAKE_LFLAGS += -Wl,--as-needed
 QMAKEFEATURES += ../../src
 
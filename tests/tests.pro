@@ -20,6 +20,8 @@ tatamimages.files += images/xmp.jpg
 tatamimages.files += images/iptc.jpg
 tatamimages.files += images/gps.jpg
 tatamimages.files += images/mnaa.jpg
+tatamimages.files += images/thumbnail.jpg
+tatamimages.files += images/makernote.jpg
 
 tatamimages.path  = $${tatam.path}/images/
 
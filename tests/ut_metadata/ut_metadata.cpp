@@ -39,9 +39,14 @@
 
 #include <QVariant>
 #include <QtTest/QtTest>
+#include <unistd.h>
 
 #include "quillmetadata.h"
 #include "quillmetadataregionlist.h"
+#include "quillmetadataprobe.h"
+#include "quillmetadatasummary.h"
+#include "quillmetadatastringpool.h"
+#include "bytesource.h"
 #include "ut_metadata.h"
 
 #define PRECISION 10000
@@ -143,6 +148,230 @@ void ut_metadata::testOrientation()
              QString("3"));
 }
 
+void ut_metadata::testTypedEntries()
+{
+    QCOMPARE(metadata->typedEntry<QuillMetadata::Tag_Orientation>(), 3);
+    QCOMPARE(metadata->typedEntry<QuillMetadata::Tag_Make>(), QString("Quill"));
+    QCOMPARE(round(metadata->typedEntry<QuillMetadata::Tag_FocalLength>() * PRECISION),
+             round(9.9 * PRECISION));
+    QCOMPARE(metadata->typedEntry<QuillMetadata::Tag_TimestampOriginal>(),
+             QDateTime(QDate(2010, 1, 25), QTime(15, 0, 0)));
+
+    QStringList reference;
+    reference << "test" << "quill";
+    QCOMPARE(xmp->typedEntry<QuillMetadata::Tag_Subject>(), reference);
+    QCOMPARE(xmp->typedEntry<QuillMetadata::Tag_City>(), QString("Tapiola"));
+    QCOMPARE(xmp->typedEntry<QuillMetadata::Tag_Rating>(), 5.0);
+
+    QCOMPARE(gps->typedEntry<QuillMetadata::Tag_GPSLatitude>(), 65.0);
+    QCOMPARE(gps->typedEntry<QuillMetadata::Tag_GPSLatitudeRef>(), QString("N"));
+
+    // Missing entries are reported through the bool overloads
+    int orientation = -1;
+    QVERIFY(!xmp->entry(QuillMetadata::Tag_Orientation, orientation));
+    QCOMPARE(orientation, -1);
+}
+
+void ut_metadata::testEntries()
+{
+    QList<QuillMetadata::Tag> tags;
+    tags << QuillMetadata::Tag_Make << QuillMetadata::Tag_Orientation
+         << QuillMetadata::Tag_City;
+
+    QMap<QuillMetadata::Tag, QVariant> entries = metadata->entries(tags);
+    QCOMPARE(entries.value(QuillMetadata::Tag_Make).toString(), QString("Quill"));
+    QCOMPARE(entries.value(QuillMetadata::Tag_Orientation).toString(), QString("3"));
+    QVERIFY(!entries.contains(QuillMetadata::Tag_City));
+
+    entries = xmp->allEntries();
+    foreach (QuillMetadata::Tag tag, entries.keys())
+        QCOMPARE(entries.value(tag), xmp->entry(tag));
+    QCOMPARE(entries.value(QuillMetadata::Tag_Subject).toStringList(),
+             QStringList() << "test" << "quill");
+    QCOMPARE(entries.value(QuillMetadata::Tag_City).toString(), QString("Tapiola"));
+
+    entries = gps->allEntries();
+    QCOMPARE(entries.value(QuillMetadata::Tag_GPSLatitude).toString(), QString("65"));
+    QCOMPARE(entries.value(QuillMetadata::Tag_GPSAltitude).toString(), QString("85"));
+}
+
+void ut_metadata::testOpaqueMakerNote()
+{
+    QuillMetadata opaque(imagePath + "exif.jpg", QuillMetadata::AllFormats,
+                         QuillMetadata::Tag_Undefined,
+                         QuillMetadata::ReadOption_OpaqueMakerNote);
+    QVERIFY(opaque.isValid());
+    QCOMPARE(opaque.entry(QuillMetadata::Tag_Make).toString(),
+             QString("Quill"));
+    QCOMPARE(opaque.dump(QuillMetadata::ExifFormat),
+             metadata->dump(QuillMetadata::ExifFormat));
+
+    // The MakerNote survives an edit byte for byte, as do unknown tags
+    const QByteArray makerNote = QByteArray::fromHex(
+        "5155494c4c4e4f5445000002000100030000000100070000"
+        "808182838485868788898a8b8c8d8e8f"
+        "909192939495969798999a9b9c9d9e9f");
+    QuillMetadata withNote(imagePath + "makernote.jpg",
+                           QuillMetadata::AllFormats,
+                           QuillMetadata::Tag_Undefined,
+                           QuillMetadata::ReadOption_OpaqueMakerNote);
+    QVERIFY(withNote.isValid());
+    QVERIFY(withNote.dump(QuillMetadata::ExifFormat).contains(makerNote));
+
+    withNote.setEntry(QuillMetadata::Tag_Model, QString("Opaque"));
+    QVERIFY(withNote.dump(QuillMetadata::ExifFormat).contains(makerNote));
+    QVERIFY(withNote.dump(QuillMetadata::ExifFormat).contains("UnknownTagValue"));
+
+    QTemporaryFile file;
+    file.open();
+    sourceImage.save(file.fileName(), "jpg");
+    QVERIFY(withNote.write(file.fileName()));
+
+    QFile written(file.fileName());
+    QVERIFY(written.open(QIODevice::ReadOnly));
+    const QByteArray contents = written.readAll();
+    QVERIFY(contents.contains(makerNote));
+    QVERIFY(contents.contains("UnknownTagValue"));
+    QCOMPARE(QuillMetadata(file.fileName()).entry(QuillMetadata::Tag_Model).toString(),
+             QString("Opaque"));
+}
+
+void ut_metadata::testCorruptIfdOffset()
+{
+    QFile source(imagePath + "exif.jpg");
+    QVERIFY(source.open(QIODevice::ReadOnly));
+    QByteArray data = source.readAll();
+
+    // Point IFD0 far past the end of the block, where an offset check
+    // which wraps around would let the reader go
+    const int tiff = data.indexOf(QByteArray("Exif\0\0", 6)) + 6;
+    QVERIFY(tiff > 6);
+    data.replace(tiff + 4, 4, QByteArray(4, '\xff'));
+
+    QTemporaryFile file;
+    file.open();
+    file.write(data);
+    file.flush();
+
+    QuillMetadata orientation(file.fileName(), QuillMetadata::ExifFormat,
+                              QuillMetadata::Tag_Orientation);
+    QVERIFY(!orientation.hasEntry(QuillMetadata::Tag_Orientation));
+
+    QuillMetadata opaque(file.fileName(), QuillMetadata::ExifFormat,
+                         QuillMetadata::Tag_Undefined,
+                         QuillMetadata::ReadOption_OpaqueMakerNote);
+    QVERIFY(!opaque.hasEntry(QuillMetadata::Tag_Make));
+}
+
+void ut_metadata::testDumpAndLoad()
+{
+    QByteArray exifBlock = metadata->dump(QuillMetadata::ExifFormat);
+    QByteArray xmpPacket = xmp->dump(QuillMetadata::XmpFormat);
+    QVERIFY(!exifBlock.isEmpty());
+    QVERIFY(!xmpPacket.isEmpty());
+    QCOMPARE(xmp->dump(QuillMetadata::XmpFormat), xmpPacket);
+
+    QuillMetadata loaded;
+    QVERIFY(loaded.loadFromData(exifBlock, QuillMetadata::ExifFormat));
+    QVERIFY(loaded.loadFromData(xmpPacket, QuillMetadata::XmpFormat));
+    QVERIFY(!loaded.loadFromData(QByteArray("garbage"),
+                                 QuillMetadata::ExifFormat));
+
+    // A block which cannot be parsed changes nothing, neither the
+    // dump nor the file written back
+    QTemporaryFile file;
+    file.open();
+    sourceImage.save(file.fileName(), "jpg");
+    QVERIFY(metadata->write(file.fileName()));
+
+    QFile source(file.fileName());
+    QVERIFY(source.open(QIODevice::ReadOnly));
+    const QByteArray contents = source.readAll();
+    source.close();
+
+    QuillMetadata unchanged(file.fileName());
+    const QByteArray unchangedBlock = unchanged.dump(QuillMetadata::ExifFormat);
+    QVERIFY(!unchanged.loadFromData(QByteArray("garbage"),
+                                    QuillMetadata::ExifFormat));
+    QCOMPARE(unchanged.dump(QuillMetadata::ExifFormat), unchangedBlock);
+    QVERIFY(unchanged.write(file.fileName()));
+
+    QVERIFY(source.open(QIODevice::ReadOnly));
+    QCOMPARE(source.readAll(), contents);
+    source.close();
+
+    // A block which can be parsed is written back
+    QuillMetadata edited(file.fileName());
+    edited.setEntry(QuillMetadata::Tag_Make, QString("Quill Loaded"));
+    QVERIFY(unchanged.loadFromData(edited.dump(QuillMetadata::ExifFormat),
+                                   QuillMetadata::ExifFormat));
+    QVERIFY(unchanged.write(file.fileName()));
+    QCOMPARE(QuillMetadata(file.fileName()).entry(QuillMetadata::Tag_Make).toString(),
+             QString("Quill Loaded"));
+
+    QCOMPARE(loaded.entry(QuillMetadata::Tag_Make).toString(),
+             QString("Quill"));
+    QCOMPARE(loaded.entry(QuillMetadata::Tag_City).toString(),
+             QString("Tapiola"));
+    QCOMPARE(loaded.entry(QuillMetadata::Tag_Subject).toStringList(),
+             QStringList() << "test" << "quill");
+}
+
+void ut_metadata::testSidecar()
+{
+    QCOMPARE(QuillMetadata::sidecarPath("/tmp/image.jpg"),
+             QString("/tmp/image.xmp"));
+
+    QTemporaryFile sidecar;
+    sidecar.open();
+    QuillMetadata edited;
+    edited.setEntry(QuillMetadata::Tag_Creator, QString("John Quill"));
+    edited.setEntry(QuillMetadata::Tag_Location, QString("Keilaniemi"));
+    QVERIFY(edited.writeSidecar(sidecar.fileName()));
+
+    QVERIFY(xmp->readSidecar(sidecar.fileName(),
+                             QuillMetadata::SidecarPrecedence_Embedded));
+    QCOMPARE(xmp->entry(QuillMetadata::Tag_Creator).toString(),
+             QString("John Q"));
+    QCOMPARE(xmp->entry(QuillMetadata::Tag_Location).toString(),
+             QString("Keilaniemi"));
+    QCOMPARE(xmp->entry(QuillMetadata::Tag_City).toString(),
+             QString("Tapiola"));
+
+    QVERIFY(xmp->readSidecar(sidecar.fileName(),
+                             QuillMetadata::SidecarPrecedence_Sidecar));
+    QCOMPARE(xmp->entry(QuillMetadata::Tag_Creator).toString(),
+             QString("John Quill"));
+
+    // A southern and western position must survive the merge with
+    // both the XMP coordinates and the EXIF references intact
+    QTemporaryFile gpsSidecar;
+    gpsSidecar.open();
+    QuillMetadata south;
+    south.setEntry(QuillMetadata::Tag_GPSLatitude, QVariant(-33.5));
+    south.setEntry(QuillMetadata::Tag_GPSLongitude, QVariant(-70.25));
+    south.setEntry(QuillMetadata::Tag_GPSAltitude, QVariant(-10));
+    QVERIFY(south.writeSidecar(gpsSidecar.fileName()));
+
+    QuillMetadata merged(imagePath + "gps.jpg");
+    QVERIFY(merged.readSidecar(gpsSidecar.fileName(),
+                               QuillMetadata::SidecarPrecedence_Sidecar));
+    QCOMPARE(merged.entry(QuillMetadata::Tag_GPSLatitude).toDouble(), 33.5);
+    QCOMPARE(merged.entry(QuillMetadata::Tag_GPSLatitudeRef).toString(),
+             QString("S"));
+    QCOMPARE(merged.entry(QuillMetadata::Tag_GPSLongitude).toDouble(), 70.25);
+    QCOMPARE(merged.entry(QuillMetadata::Tag_GPSLongitudeRef).toString(),
+             QString("W"));
+    QCOMPARE(merged.entry(QuillMetadata::Tag_GPSAltitude).toDouble(), 10.0);
+    QCOMPARE(merged.entry(QuillMetadata::Tag_GPSAltitudeRef).toInt(), 1);
+
+    const QByteArray mergedXmp = merged.dump(QuillMetadata::XmpFormat);
+    QVERIFY(mergedXmp.contains("33,30,0S"));
+    QVERIFY(mergedXmp.contains("70,15,0W"));
+
+    QVERIFY(!xmp->readSidecar(sidecar.fileName() + ".missing"));
+}
+
 void ut_metadata::testSubject()
 {
     QVERIFY(xmp->isValid());
@@ -208,6 +437,20 @@ void ut_metadata::testCountryIptc()
              QString("Finland"));
 }
 
+void ut_metadata::testNativeIptc()
+{
+    QuillMetadata iptcOnly(imagePath + "iptc.jpg", QuillMetadata::IptcFormat);
+    QVERIFY(iptcOnly.isValid());
+    QCOMPARE(iptcOnly.entry(QuillMetadata::Tag_City).toString(),
+             QString("Tapiola"));
+    QCOMPARE(iptcOnly.typedEntry<QuillMetadata::Tag_Country>(),
+             QString("Finland"));
+    QVERIFY(iptcOnly.entry(QuillMetadata::Tag_Make).isNull());
+
+    iptcOnly.removeEntry(QuillMetadata::Tag_City);
+    QVERIFY(iptcOnly.entry(QuillMetadata::Tag_City).isNull());
+}
+
 void ut_metadata::testWriteSubject()
 {
     QTemporaryFile file;
@@ -277,6 +520,272 @@ void ut_metadata::testEditCameraMake()
              QString("Quill"));
 }
 
+void ut_metadata::testEditLongerCameraMake()
+{
+    QTemporaryFile file;
+    file.open();
+    sourceImage.save(file.fileName(), "jpg");
+    metadata->setEntry(QuillMetadata::Tag_Make,
+                       QByteArray("Quill Metadata Library"));
+    QVERIFY(metadata->write(file.fileName()));
+
+    QuillMetadata writtenMetadata(file.fileName());
+    QVERIFY(writtenMetadata.isValid());
+    QCOMPARE(writtenMetadata.entry(QuillMetadata::Tag_Make).toString(),
+             QString("Quill Metadata Library"));
+}
+
+void ut_metadata::testPatchExif()
+{
+    QuillMetadata exif(imagePath + "exif.jpg");
+    const QByteArray original = exif.dump(QuillMetadata::ExifFormat);
+
+    // A value of the same size is overwritten where it was
+    exif.setEntry(QuillMetadata::Tag_Orientation, 6);
+    QByteArray patched = exif.dump(QuillMetadata::ExifFormat);
+    QCOMPARE(patched.size(), original.size());
+
+    // A longer one moves its IFD to the end of the block
+    exif.setEntry(QuillMetadata::Tag_Make, QByteArray("Quill Metadata Library"));
+    patched = exif.dump(QuillMetadata::ExifFormat);
+    QVERIFY(patched.size() > original.size());
+    QVERIFY(patched.startsWith(original.left(8)));
+
+    QuillMetadata loaded;
+    QVERIFY(loaded.loadFromData(patched, QuillMetadata::ExifFormat));
+    QCOMPARE(loaded.entry(QuillMetadata::Tag_Orientation).toInt(), 6);
+    QCOMPARE(loaded.entry(QuillMetadata::Tag_Make).toString(),
+             QString("Quill Metadata Library"));
+    QCOMPARE(loaded.entry(QuillMetadata::Tag_FocalLength),
+             metadata->entry(QuillMetadata::Tag_FocalLength));
+    QCOMPARE(loaded.entry(QuillMetadata::Tag_TimestampOriginal),
+             metadata->entry(QuillMetadata::Tag_TimestampOriginal));
+
+    // An Exif IFD pointer near 4 GB must not wrap around the bounds checks
+    QuillMetadata crafted;
+    QVERIFY(crafted.loadFromData(QByteArray::fromHex(
+        "457869660000" "49492a0008000000"
+        "0200"
+        "0f01020006000000" "26000000"   // Make, "Quill" after the IFD
+        "6987040001000000" "ffffffff"   // Exif IFD pointer
+        "00000000"
+        "5175696c6c00"), QuillMetadata::ExifFormat));
+    crafted.setEntry(QuillMetadata::Tag_Make, QString("Quill Metadata Library"));
+    QVERIFY(crafted.dump(QuillMetadata::ExifFormat).contains("Quill Metadata Library"));
+}
+
+void ut_metadata::testThumbnail()
+{
+    QVERIFY(metadata->thumbnail().isEmpty());
+    QVERIFY(!metadata->thumbnailSize().isValid());
+
+    QuillMetadata thumbnail(imagePath + "thumbnail.jpg");
+    QVERIFY(thumbnail.thumbnail().startsWith("\xff\xd8"));
+    QCOMPARE(thumbnail.thumbnailSize(), QSize(2, 2));
+
+    QuillMetadata orientation(imagePath + "thumbnail.jpg",
+                              QuillMetadata::ExifFormat,
+                              QuillMetadata::Tag_Orientation);
+    QCOMPARE(orientation.thumbnail(), thumbnail.thumbnail());
+    QCOMPARE(orientation.thumbnailSize(), QSize(2, 2));
+}
+
+void ut_metadata::testGenerateThumbnail()
+{
+    QTemporaryFile file;
+    file.open();
+    QImage image(QSize(64, 32), QImage::Format_RGB32);
+    image.fill(qRgb(255, 0, 0));
+    image.save(file.fileName(), "jpg");
+
+    QVERIFY(metadata->write(file.fileName(), QuillMetadata::ExifFormat,
+                            QuillMetadata::WriteOption_GenerateThumbnail));
+
+    QuillMetadata written(file.fileName());
+    QCOMPARE(written.entry(QuillMetadata::Tag_Make).toString(),
+             QString("Quill"));
+    QCOMPARE(written.thumbnailSize(), QSize(8, 4));
+    QCOMPARE(QImage::fromData(written.thumbnail(), "jpg").pixel(0, 0) & 0xc0c0c0,
+             qRgb(255, 0, 0) & 0xc0c0c0);
+}
+
+void ut_metadata::testFrame()
+{
+    QCOMPARE(metadata->imageSize(), QSize(2, 2));
+    QCOMPARE(metadata->componentCount(), 3);
+    QVERIFY(!metadata->isProgressive());
+    QCOMPARE(metadata->samplingFactors(),
+             QList<QSize>() << QSize(2, 2) << QSize(1, 1) << QSize(1, 1));
+
+    QuillMetadata orientation(imagePath + "exif.jpg", QuillMetadata::ExifFormat,
+                              QuillMetadata::Tag_Orientation);
+    QCOMPARE(orientation.imageSize(), QSize(2, 2));
+
+    QuillMetadata empty;
+    QVERIFY(!empty.imageSize().isValid());
+    QCOMPARE(empty.componentCount(), 0);
+}
+
+void ut_metadata::testDeferredXmp()
+{
+    // XMP is not read, but an empty packet can still be edited
+    QuillMetadata exifOnly(imagePath + "xmp.jpg", QuillMetadata::ExifFormat);
+    QVERIFY(exifOnly.isValid());
+    QVERIFY(exifOnly.entry(QuillMetadata::Tag_Creator).isNull());
+    QVERIFY(exifOnly.dump(QuillMetadata::XmpFormat).isEmpty());
+
+    exifOnly.setEntry(QuillMetadata::Tag_Creator, QString("John Quill"));
+    QCOMPARE(exifOnly.entry(QuillMetadata::Tag_Creator).toString(),
+             QString("John Quill"));
+    QVERIFY(exifOnly.dump(QuillMetadata::XmpFormat).contains("John Quill"));
+
+    // exempi is already loaded here, so check in a fresh process that an
+    // Exif-only read leaves it unloaded
+    QProcess child;
+    child.start(QCoreApplication::applicationFilePath(),
+                QStringList() << "-exif-only-read" << imagePath + "xmp.jpg");
+    QVERIFY(child.waitForFinished());
+    QCOMPARE(child.exitStatus(), QProcess::NormalExit);
+    QCOMPARE(child.exitCode(), 0);
+}
+
+void ut_metadata::testSummary()
+{
+    QuillMetadataSummary summary(imagePath + "exif.jpg");
+    QVERIFY(summary.isValid());
+    QCOMPARE(summary.make(), QString("Quill"));
+    QCOMPARE(summary.model(), QString("Q100125"));
+    QCOMPARE(summary.orientation(), 3);
+    QVERIFY(summary.hasEntry(QuillMetadata::Tag_TimestampOriginal));
+    QCOMPARE(summary.timestamp(),
+             metadata->typedEntry<QuillMetadata::Tag_TimestampOriginal>().toMSecsSinceEpoch());
+    QVERIFY(!summary.hasEntry(QuillMetadata::Tag_GPSLatitude));
+
+    QuillMetadataSummary location(*gps);
+    QVERIFY(location.hasEntry(QuillMetadata::Tag_GPSLatitude));
+    QCOMPARE(location.latitude(), 65.0);
+    QCOMPARE(location.longitude(), 30.0);
+    QCOMPARE(location.altitude(), 85.0);
+
+    QuillMetadataSummary empty;
+    QVERIFY(!empty.isValid());
+    QCOMPARE(empty.orientation(), 0);
+}
+
+void ut_metadata::testStringPool()
+{
+    QString make("Quill");
+    QCOMPARE(QuillMetadataStringPool::intern(make).constData(),
+             make.constData());
+
+    QuillMetadataStringPool::setEnabled(true);
+    QuillMetadataSummary first(imagePath + "exif.jpg");
+    QuillMetadataSummary second(imagePath + "exif.jpg");
+    QCOMPARE(first.make(), QString("Quill"));
+    QCOMPARE(first.make().constData(), second.make().constData());
+    QCOMPARE(QuillMetadataStringPool::intern(make).constData(),
+             first.make().constData());
+
+    QuillMetadataStringPool::setEnabled(false);
+    QuillMetadataStringPool::clear();
+    QCOMPARE(QuillMetadataStringPool::size(), 0);
+    QCOMPARE(first.make(), QString("Quill"));
+}
+
+void ut_metadata::testAsync()
+{
+    QFuture<QMap<QuillMetadata::Tag, QVariant> > read =
+        QuillMetadata::readAsync(imagePath + "exif.jpg", QuillMetadata::AllFormats,
+                                 QList<QuillMetadata::Tag>() << QuillMetadata::Tag_Make);
+    read.waitForFinished();
+    QCOMPARE(read.result().size(), 1);
+    QCOMPARE(read.result().value(QuillMetadata::Tag_Make).toString(),
+             QString("Quill"));
+
+    QTemporaryFile file;
+    file.open();
+    sourceImage.save(file.fileName(), "jpg");
+    QuillMetadata *edited = new QuillMetadata;
+    edited->setEntry(QuillMetadata::Tag_Make, QString("Async Quill"));
+    QFuture<bool> write = edited->writeAsync(file.fileName());
+    // The object is not needed by the write
+    delete edited;
+    write.waitForFinished();
+    QVERIFY(write.result());
+
+    QuillMetadata written(file.fileName());
+    QCOMPARE(written.entry(QuillMetadata::Tag_Make).toString(),
+             QString("Async Quill"));
+}
+
+void ut_metadata::testConcurrentReadAsync()
+{
+    // The tag tables are filled by now, so start the reads in a fresh
+    // process where the first ones race to initialize them
+    QProcess child;
+    child.start(QCoreApplication::applicationFilePath(),
+                QStringList() << "-concurrent-read" << imagePath);
+    QVERIFY(child.waitForFinished());
+    QCOMPARE(child.exitStatus(), QProcess::NormalExit);
+    QCOMPARE(child.exitCode(), 0);
+}
+
+void ut_metadata::testWriteUnmodified()
+{
+    QTemporaryFile file;
+    file.open();
+    sourceImage.save(file.fileName(), "jpg");
+    QVERIFY(metadata->write(file.fileName()));
+    QVERIFY(xmp->write(file.fileName(), QuillMetadata::XmpFormat));
+
+    QFile source(file.fileName());
+    QVERIFY(source.open(QIODevice::ReadOnly));
+    const QByteArray contents = source.readAll();
+    source.close();
+
+    QuillMetadata readMetadata(file.fileName());
+    QVERIFY(readMetadata.write(file.fileName()));
+
+    QVERIFY(source.open(QIODevice::ReadOnly));
+    QCOMPARE(source.readAll(), contents);
+    source.close();
+
+    // Modifying one block keeps the other one
+    readMetadata.setEntry(QuillMetadata::Tag_Make, QString("Quill2"));
+    QVERIFY(readMetadata.write(file.fileName()));
+
+    QuillMetadata writtenMetadata(file.fileName());
+    QCOMPARE(writtenMetadata.entry(QuillMetadata::Tag_Make).toString(),
+             QString("Quill2"));
+    QCOMPARE(writtenMetadata.entry(QuillMetadata::Tag_City).toString(),
+             QString("Tapiola"));
+}
+
+void ut_metadata::testWriteUnchangedValue()
+{
+    QTemporaryFile file;
+    file.open();
+    sourceImage.save(file.fileName(), "jpg");
+    QVERIFY(metadata->write(file.fileName()));
+    QVERIFY(xmp->write(file.fileName(), QuillMetadata::XmpFormat));
+
+    QFile source(file.fileName());
+    QVERIFY(source.open(QIODevice::ReadOnly));
+    const QByteArray contents = source.readAll();
+    source.close();
+
+    QuillMetadata readMetadata(file.fileName());
+    readMetadata.setEntry(QuillMetadata::Tag_Make,
+                          readMetadata.entry(QuillMetadata::Tag_Make));
+    readMetadata.setEntry(QuillMetadata::Tag_Rating,
+                          readMetadata.entry(QuillMetadata::Tag_Rating));
+    QVERIFY(readMetadata.write(file.fileName()));
+
+    QVERIFY(source.open(QIODevice::ReadOnly));
+    QCOMPARE(source.readAll(), contents);
+    source.close();
+}
+
 void ut_metadata::testEditOrientation()
 {
     QTemporaryFile file;
@@ -292,6 +801,22 @@ void ut_metadata::testEditOrientation()
              QString("7"));
 }
 
+void ut_metadata::testEditTimestampOriginal()
+{
+    QTemporaryFile file;
+    file.open();
+    sourceImage.save(file.fileName(), "jpg");
+    QuillMetadata empty;
+    empty.setEntry(QuillMetadata::Tag_TimestampOriginal,
+                   QByteArray("2011:11:11 11:11:11"));
+    QVERIFY(empty.write(file.fileName()));
+
+    QuillMetadata writtenMetadata(file.fileName());
+    QVERIFY(writtenMetadata.isValid());
+    QCOMPARE(writtenMetadata.entry(QuillMetadata::Tag_TimestampOriginal).toString(),
+             QString("2011:11:11 11:11:11"));
+}
+
 void ut_metadata::testEditCity()
 {
     QTemporaryFile file;
@@ -587,6 +1112,14 @@ void ut_metadata::testEditGps_altitude()
     // Manually setting the altitude reference
     editMetadata.setEntry(QuillMetadata::Tag_GPSAltitudeRef, QVariant(int(1)));
     QCOMPARE(editMetadata.entry(QuillMetadata::Tag_GPSAltitudeRef).toString(), QString("1"));
+
+    // The reference is a number, also where it would be an ASCII digit
+    QuillMetadata exifOnly;
+    exifOnly.setEntry(QuillMetadata::Tag_GPSAltitudeRef, QVariant(int('2')));
+    QuillMetadata reloaded;
+    QVERIFY(reloaded.loadFromData(exifOnly.dump(QuillMetadata::ExifFormat),
+                                  QuillMetadata::ExifFormat));
+    QCOMPARE(reloaded.typedEntry<QuillMetadata::Tag_GPSAltitudeRef>(), int('2'));
 }
 
 void ut_metadata::testEditGps_direction()
@@ -663,6 +1196,144 @@ void ut_metadata::testCanRead()
     QVERIFY(!QuillMetadata::canRead(file.fileName()));
 }
 
+void ut_metadata::testProbe()
+{
+    QuillMetadataProbe exif(imagePath + "exif.jpg");
+    QCOMPARE(exif.format(), QuillMetadataProbe::Format_Jpeg);
+    QVERIFY(exif.hasBlock(QuillMetadataProbe::Block_Exif));
+    QCOMPARE(exif.blockOffset(QuillMetadataProbe::Block_Exif), qint64(46));
+    QCOMPARE(exif.blockSize(QuillMetadataProbe::Block_Exif), 252);
+    QVERIFY(exif.hasBlock(QuillMetadataProbe::Block_Iptc));
+    QVERIFY(!exif.hasBlock(QuillMetadataProbe::Block_Xmp));
+    QVERIFY(!exif.hasBlock(QuillMetadataProbe::Block_Icc));
+
+    QuillMetadataProbe xmpProbe(imagePath + "xmp.jpg");
+    QCOMPARE(xmpProbe.blockOffset(QuillMetadataProbe::Block_Xmp), qint64(24));
+    QCOMPARE(xmpProbe.blockSize(QuillMetadataProbe::Block_Xmp), 3542);
+    QVERIFY(!xmpProbe.hasBlock(QuillMetadataProbe::Block_Exif));
+
+    QuillMetadata probed(exif);
+    QCOMPARE(probed.entry(QuillMetadata::Tag_Make).toString(),
+             QString("Quill"));
+    QCOMPARE(probed.dump(QuillMetadata::ExifFormat),
+             metadata->dump(QuillMetadata::ExifFormat));
+    QCOMPARE(probed.imageSize(), QSize(2, 2));
+
+    QTemporaryFile file;
+    file.open();
+    QCOMPARE(QuillMetadataProbe(file.fileName()).format(),
+             QuillMetadataProbe::Format_Unknown);
+}
+
+void ut_metadata::testBatchProbe()
+{
+    QList<QuillMetadataProbe> probes =
+        QuillMetadataProbe::probe(QStringList() << imagePath + "exif.jpg"
+                                  << imagePath + "nonexistent.jpg"
+                                  << imagePath + "xmp.jpg");
+    QCOMPARE(probes.size(), 3);
+    QCOMPARE(probes[0].fileName(), imagePath + "exif.jpg");
+    QCOMPARE(probes[0].blockOffset(QuillMetadataProbe::Block_Exif), qint64(46));
+    QCOMPARE(probes[0].blockSize(QuillMetadataProbe::Block_Exif), 252);
+    QCOMPARE(probes[1].format(), QuillMetadataProbe::Format_Unknown);
+    QCOMPARE(probes[2].blockSize(QuillMetadataProbe::Block_Xmp), 3542);
+
+    QuillMetadata probed(probes[0]);
+    QCOMPARE(probed.dump(QuillMetadata::ExifFormat),
+             metadata->dump(QuillMetadata::ExifFormat));
+    QCOMPARE(probed.imageSize(), QSize(2, 2));
+}
+
+void ut_metadata::testHeaderOnlyRead()
+{
+    // Without its image data, a file still gives all of its metadata
+    QFile source(imagePath + "xmp.jpg");
+    QVERIFY(source.open(QIODevice::ReadOnly));
+    const QByteArray data = source.readAll();
+    const int imageData = data.indexOf("\xff\xda");
+    QVERIFY(imageData > 0);
+
+    QTemporaryFile file;
+    file.open();
+    file.write(data.left(imageData + 2));
+    file.close();
+
+    QuillMetadata header(file.fileName());
+    QVERIFY(header.isValid());
+    QCOMPARE(header.entry(QuillMetadata::Tag_Creator),
+             xmp->entry(QuillMetadata::Tag_Creator));
+    QCOMPARE(header.dump(QuillMetadata::XmpFormat),
+             xmp->dump(QuillMetadata::XmpFormat));
+}
+
+void ut_metadata::testByteSource()
+{
+    QFile exifFile(imagePath + "exif.jpg");
+    QVERIFY(exifFile.open(QIODevice::ReadOnly));
+    const QByteArray exifData = exifFile.readAll();
+
+    MemoryByteSource memory(exifData.constData(), exifData.size());
+    QuillMetadata fromMemory(memory);
+    QCOMPARE(fromMemory.dump(QuillMetadata::ExifFormat),
+             metadata->dump(QuillMetadata::ExifFormat));
+    QCOMPARE(fromMemory.imageSize(), QSize(2, 2));
+
+    // Of a large image in remote storage, only the header is fetched
+    QFile xmpFile(imagePath + "xmp.jpg");
+    QVERIFY(xmpFile.open(QIODevice::ReadOnly));
+    QTemporaryFile file;
+    file.open();
+    file.write(xmpFile.readAll());
+    file.write(QByteArray(256 * 1024, '\0'));
+    file.close();
+
+    FileByteSource local(QFile::encodeName(file.fileName()).constData());
+    QVERIFY(local.isOpen());
+    RangeByteSource remote(local, 4096);
+    QuillMetadata fromRemote(remote);
+    QCOMPARE(fromRemote.dump(QuillMetadata::XmpFormat),
+             xmp->dump(QuillMetadata::XmpFormat));
+    QCOMPARE(remote.requestCount(), 1);
+    QCOMPARE(remote.transferredSize(), 4096LL);
+}
+
+void ut_metadata::testFileDescriptor()
+{
+    QFile source(imagePath + "exif.jpg");
+    QVERIFY(source.open(QIODevice::ReadOnly));
+
+    QTemporaryFile file;
+    file.open();
+    file.write(source.readAll());
+    file.flush();
+    const int fd = file.handle();
+    const off_t offset = lseek(fd, 0, SEEK_CUR);
+
+    QuillMetadata fromFd(fd);
+    QVERIFY(fromFd.isValid());
+    QCOMPARE(fromFd.dump(QuillMetadata::ExifFormat),
+             metadata->dump(QuillMetadata::ExifFormat));
+
+    fromFd.setEntry(QuillMetadata::Tag_Make, QString("Fd"));
+    fromFd.setEntry(QuillMetadata::Tag_Creator, QString("John Quill"));
+    QVERIFY(fromFd.write(fd));
+    // Only pread() and pwrite() are used, which leave the offset alone
+    QCOMPARE(lseek(fd, 0, SEEK_CUR), offset);
+
+    QuillMetadata written(file.fileName());
+    QCOMPARE(written.entry(QuillMetadata::Tag_Make).toString(), QString("Fd"));
+    QCOMPARE(written.entry(QuillMetadata::Tag_Creator).toString(),
+             QString("John Quill"));
+    QCOMPARE(written.imageSize(), QSize(2, 2));
+
+    // The packet is wrapped, as when written through exempi
+    QFile writtenFile(file.fileName());
+    QVERIFY(writtenFile.open(QIODevice::ReadOnly));
+    const QByteArray contents = writtenFile.readAll();
+    QVERIFY(contents.contains("<?xpacket begin="));
+    QVERIFY(contents.contains("<?xpacket end=\"w\"?>"));
+}
+
 //we add the case to test dump function by creating medatedata object with file name from other team.
 void ut_metadata::testSetOrientationTag()
 {
@@ -711,7 +1382,48 @@ void ut_metadata::testOrientationTagSpeedup()
 }
 
 
+// Reads only Exif and reports through the exit code whether exempi
+// got loaded; run as a child process by testDeferredXmp
+static int exifOnlyRead(const QString &fileName)
+{
+    QuillMetadata metadata(fileName, QuillMetadata::ExifFormat);
+    if (!metadata.isValid())
+        return 2;
+
+    QFile maps("/proc/self/maps");
+    if (!maps.open(QIODevice::ReadOnly))
+        return 3;
+    return maps.readAll().contains("libexempi") ? 1 : 0;
+}
+
+// Starts many reads at once before any metadata object exists, and
+// reports through the exit code whether all of them succeeded; run as
+// a child process by testConcurrentReadAsync
+static int concurrentRead(const QString &imagePath)
+{
+    const int readCount = 32;
+    QuillMetadata::threadPool()->setMaxThreadCount(8);
+
+    QList<QFuture<QMap<QuillMetadata::Tag, QVariant> > > reads;
+    for (int i = 0; i < readCount; i++)
+        reads << QuillMetadata::readAsync(imagePath + ((i % 2) ? "xmp.jpg" : "exif.jpg"));
+
+    for (int i = 0; i < readCount; i++) {
+        const QMap<QuillMetadata::Tag, QVariant> entries = reads[i].result();
+        if ((i % 2) ?
+            (entries.value(QuillMetadata::Tag_City).toString() != "Tapiola") :
+            (entries.value(QuillMetadata::Tag_Make).toString() != "Quill"))
+            return 1;
+    }
+    return 0;
+}
+
 int main ( int argc, char *argv[] ){
+    if ((argc == 3) && (QByteArray(argv[1]) == "-exif-only-read"))
+        return exifOnlyRead(QString::fromLocal8Bit(argv[2]));
+    if ((argc == 3) && (QByteArray(argv[1]) == "-concurrent-read"))
+        return concurrentRead(QString::fromLocal8Bit(argv[2]));
+
     QCoreApplication app( argc, argv );
     ut_metadata test;
     return QTest::qExec( &test, argc, argv );
@@ -69,9 +69,19 @@ private slots:
     void testCreator();
     void testCityIptc();
     void testCountryIptc();
+    void testNativeIptc();
     void testDescription();
     void testTitle();
     void testOrientation();
+    void testTypedEntries();
+    void testEntries();
+    void testOpaqueMakerNote();
+    void testCorruptIfdOffset();
+    void testDumpAndLoad();
+    void testSidecar();
+    void testDeferredXmp();
+    void testSummary();
+    void testStringPool();
 
     // Unit tests for metadata writing
 
@@ -83,7 +93,17 @@ private slots:
     // Unit tests for metadata editing
 
     void testEditCameraMake();
+    void testEditLongerCameraMake();
+    void testWriteUnmodified();
+    void testPatchExif();
+    void testThumbnail();
+    void testGenerateThumbnail();
+    void testFrame();
+    void testAsync();
+    void testConcurrentReadAsync();
+    void testWriteUnchangedValue();
     void testEditOrientation();
+    void testEditTimestampOriginal();
     void testOrientationTagSpeedup();
     void testEditCity();
     void testEditKeywords();
@@ -111,6 +131,11 @@ private slots:
     // Unit tests for format detection
 
     void testCanRead();
+    void testProbe();
+    void testBatchProbe();
+    void testHeaderOnlyRead();
+    void testByteSource();
+    void testFileDescriptor();
     void testSetOrientationTag();
 
 private: